@@ -0,0 +1,296 @@
+#include "pg_prelude.h"
+
+#include "audit.h"
+#include "shmem.h"
+
+// records that are not yet written when the ring is full are dropped, the
+// writer logs how many
+#define AUDIT_RING_SIZE 1024
+
+// records are written in batches, one transaction and one write() per batch
+#define AUDIT_BATCH_SIZE 64
+
+typedef struct {
+  slock_t      mutex;
+  uint64       head; // next slot to fill
+  uint64       tail; // next slot to write
+  uint64       dropped;
+  Latch       *writer_latch;
+  audit_record records[AUDIT_RING_SIZE];
+} audit_ring;
+
+static audit_ring *ring              = NULL;
+static bool        worker_registered = false;
+
+static void audit_ring_init(void *ptr) {
+  audit_ring *r = ptr;
+
+  SpinLockInit(&r->mutex);
+  r->head         = 0;
+  r->tail         = 0;
+  r->dropped      = 0;
+  r->writer_latch = NULL;
+}
+
+void init_audit(bool enabled) {
+  BackgroundWorker worker = {0};
+
+  if (!enabled || !process_shared_preload_libraries_in_progress) return;
+
+  request_named_shmem(sizeof(audit_ring));
+
+  worker.bgw_flags =
+      BGWORKER_SHMEM_ACCESS | BGWORKER_BACKEND_DATABASE_CONNECTION;
+  worker.bgw_start_time   = BgWorkerStart_RecoveryFinished;
+  worker.bgw_restart_time = 10;
+  strlcpy(worker.bgw_library_name, "supautils", BGW_MAXLEN);
+  strlcpy(worker.bgw_function_name, "supautils_audit_main", BGW_MAXLEN);
+  strlcpy(worker.bgw_name, "supautils audit writer", BGW_MAXLEN);
+  strlcpy(worker.bgw_type, "supautils audit writer", BGW_MAXLEN);
+
+  RegisterBackgroundWorker(&worker);
+
+  worker_registered = true;
+}
+
+bool audit_enabled(void) { return worker_registered; }
+
+static audit_ring *get_ring(void) {
+  if (ring == NULL)
+    ring = get_named_shmem("supautils_audit", sizeof(audit_ring),
+                           audit_ring_init);
+
+  return ring;
+}
+
+static const char *rolespec_name(RoleSpec *spec) {
+  if (spec == NULL || spec->roletype != ROLESPEC_CSTRING) return NULL;
+
+  return spec->rolename;
+}
+
+// Objects are either a plain name or a qualified name list. Other lists, like
+// the types of a CAST or TRANSFORM, have no name.
+static const char *object_name(Node *obj) {
+  ListCell *lc;
+
+  if (obj == NULL) return NULL;
+
+  if (IsA(obj, String)) return strVal(obj);
+
+  if (!IsA(obj, List)) return NULL;
+
+  foreach (lc, (List *)obj) {
+    if (!IsA(lfirst(lc), String)) return NULL;
+  }
+
+  return NameListToString((List *)obj);
+}
+
+const char *statement_object(Node *stmt) {
+  switch (nodeTag(stmt)) {
+  case T_AlterRoleStmt: return rolespec_name(((AlterRoleStmt *)stmt)->role);
+  case T_AlterRoleSetStmt:
+    return rolespec_name(((AlterRoleSetStmt *)stmt)->role);
+  case T_CreateRoleStmt: return ((CreateRoleStmt *)stmt)->role;
+  case T_DropRoleStmt: {
+    List *roles = ((DropRoleStmt *)stmt)->roles;
+    return roles != NIL ? rolespec_name(linitial(roles)) : NULL;
+  }
+  case T_GrantRoleStmt: {
+    List *granted = ((GrantRoleStmt *)stmt)->granted_roles;
+    return granted != NIL ? ((AccessPriv *)linitial(granted))->priv_name
+                          : NULL;
+  }
+  case T_RenameStmt: return ((RenameStmt *)stmt)->subname;
+  case T_CreateExtensionStmt: return ((CreateExtensionStmt *)stmt)->extname;
+  case T_AlterExtensionStmt: return ((AlterExtensionStmt *)stmt)->extname;
+  case T_AlterObjectSchemaStmt:
+    return object_name(((AlterObjectSchemaStmt *)stmt)->object);
+  case T_CreateFdwStmt: return ((CreateFdwStmt *)stmt)->fdwname;
+  case T_CreatePublicationStmt:
+    return ((CreatePublicationStmt *)stmt)->pubname;
+  case T_AlterPublicationStmt: return ((AlterPublicationStmt *)stmt)->pubname;
+  case T_CreatePolicyStmt: return ((CreatePolicyStmt *)stmt)->policy_name;
+  case T_AlterPolicyStmt: return ((AlterPolicyStmt *)stmt)->policy_name;
+  case T_DropStmt: {
+    List *objects = ((DropStmt *)stmt)->objects;
+    return objects != NIL ? object_name(linitial(objects)) : NULL;
+  }
+  case T_CommentStmt: return object_name(((CommentStmt *)stmt)->object);
+  case T_VariableSetStmt: return ((VariableSetStmt *)stmt)->name;
+  case T_CreateEventTrigStmt: return ((CreateEventTrigStmt *)stmt)->trigname;
+  case T_AlterTableStmt: return ((AlterTableStmt *)stmt)->relation->relname;
+  case T_IndexStmt: return ((IndexStmt *)stmt)->relation->relname;
+  case T_ReindexStmt: {
+    RangeVar *relation = ((ReindexStmt *)stmt)->relation;
+    return relation != NULL ? relation->relname : ((ReindexStmt *)stmt)->name;
+  }
+  default: return NULL;
+  }
+}
+
+void audit_start(audit_record *rec, Oid role, Node *stmt) {
+  const char *object = statement_object(stmt);
+
+  // resolved here since audit_finish() can't throw
+  get_ring();
+
+  rec->time         = GetCurrentStatementStartTimestamp();
+  rec->role         = role;
+  rec->escalated_to = InvalidOid;
+  rec->command      = CreateCommandTag(stmt);
+  rec->succeeded    = false;
+  strlcpy(rec->object, object != NULL ? object : "", NAMEDATALEN);
+}
+
+void audit_finish(audit_record *rec, Oid escalated_to, bool succeeded) {
+  Latch *writer_latch;
+
+  if (ring == NULL) return;
+
+  rec->escalated_to = escalated_to;
+  rec->succeeded    = succeeded;
+
+  SpinLockAcquire(&ring->mutex);
+  if (ring->head - ring->tail < AUDIT_RING_SIZE) {
+    ring->records[ring->head % AUDIT_RING_SIZE] = *rec;
+    ring->head++;
+  } else {
+    ring->dropped++;
+  }
+  writer_latch = ring->writer_latch;
+  SpinLockRelease(&ring->mutex);
+
+  if (writer_latch != NULL) SetLatch(writer_latch);
+}
+
+static void append_csv_field(StringInfo buf, const char *value) {
+  appendStringInfoChar(buf, '"');
+  for (const char *c = value; *c != '\0'; c++) {
+    if (*c == '"') appendStringInfoChar(buf, '"');
+    appendStringInfoChar(buf, *c);
+  }
+  appendStringInfoChar(buf, '"');
+}
+
+static void append_role(StringInfo buf, Oid role) {
+  char *name;
+
+  if (!OidIsValid(role)) return;
+
+  // the role may have been dropped since
+  name = GetUserNameFromId(role, true);
+  if (name != NULL)
+    append_csv_field(buf, name);
+  else
+    appendStringInfo(buf, "%u", role);
+}
+
+static void write_records(const audit_record *batch, int total) {
+  const char    *path = GetConfigOption("supautils.audit_file", false, false);
+  StringInfoData buf;
+  FILE          *file;
+
+  // for the role names, the memory is released on commit
+  StartTransactionCommand();
+
+  initStringInfo(&buf);
+
+  for (int i = 0; i < total; i++) {
+    const audit_record *rec = &batch[i];
+
+    appendStringInfo(&buf, "%s,", timestamptz_to_str(rec->time));
+    append_role(&buf, rec->role);
+    appendStringInfoChar(&buf, ',');
+    append_role(&buf, rec->escalated_to);
+    appendStringInfo(&buf, ",%s,", GetCommandTagName(rec->command));
+    append_csv_field(&buf, rec->object);
+    appendStringInfo(&buf, ",%s\n", rec->succeeded ? "succeeded" : "failed");
+  }
+
+  file = AllocateFile(path, PG_BINARY_A);
+  if (file == NULL) {
+    ereport(LOG, (errcode_for_file_access(),
+                  errmsg("could not open audit file \"%s\": %m", path)));
+  } else {
+    if (fwrite(buf.data, 1, buf.len, file) != (size_t)buf.len)
+      ereport(LOG, (errcode_for_file_access(),
+                    errmsg("could not write audit file \"%s\": %m", path)));
+    FreeFile(file);
+  }
+
+  CommitTransactionCommand();
+}
+
+static void drain_ring(audit_ring *r) {
+  audit_record batch[AUDIT_BATCH_SIZE];
+
+  for (;;) {
+    uint64 total;
+    uint64 dropped;
+
+    // copy at most up to the end of the ring, the rest is taken on the next
+    // iteration
+    SpinLockAcquire(&r->mutex);
+    total = Min(r->head - r->tail, AUDIT_RING_SIZE - r->tail % AUDIT_RING_SIZE);
+    total = Min(total, AUDIT_BATCH_SIZE);
+    memcpy(batch, &r->records[r->tail % AUDIT_RING_SIZE],
+           total * sizeof(audit_record));
+    r->tail += total;
+    dropped    = r->dropped;
+    r->dropped = 0;
+    SpinLockRelease(&r->mutex);
+
+    if (dropped > 0)
+      ereport(LOG, (errmsg("supautils audit dropped " UINT64_FORMAT
+                           " records, the ring buffer was full",
+                           dropped)));
+
+    if (total == 0) return;
+
+    write_records(batch, (int)total);
+  }
+}
+
+static void detach_writer_latch(__attribute__((unused)) int   code,
+                                __attribute__((unused)) Datum arg) {
+  SpinLockAcquire(&ring->mutex);
+  ring->writer_latch = NULL;
+  SpinLockRelease(&ring->mutex);
+}
+
+void supautils_audit_main(__attribute__((unused)) Datum arg) {
+  pqsignal(SIGHUP, SignalHandlerForConfigReload);
+  pqsignal(SIGTERM, SignalHandlerForShutdownRequest);
+  BackgroundWorkerUnblockSignals();
+
+  // only shared catalogs are needed, to look up the role names
+  BackgroundWorkerInitializeConnection(NULL, NULL, 0);
+
+  get_ring();
+
+  SpinLockAcquire(&ring->mutex);
+  ring->writer_latch = MyLatch;
+  SpinLockRelease(&ring->mutex);
+
+  before_shmem_exit(detach_writer_latch, (Datum)0);
+
+  for (;;) {
+    ResetLatch(MyLatch);
+
+    CHECK_FOR_INTERRUPTS();
+
+    if (ConfigReloadPending) {
+      ConfigReloadPending = false;
+      ProcessConfigFile(PGC_SIGHUP);
+    }
+
+    drain_ring(ring);
+
+    if (ShutdownRequestPending) proc_exit(0);
+
+    (void)WaitLatch(MyLatch, WL_LATCH_SET | WL_EXIT_ON_PM_DEATH, -1L,
+                    PG_WAIT_EXTENSION);
+  }
+}
@@ -0,0 +1,42 @@
+#ifndef AUDIT_H
+#define AUDIT_H
+
+#include "pg_prelude.h"
+
+typedef struct {
+  TimestampTz time;
+  Oid         role;
+  Oid         escalated_to; // InvalidOid when the statement ran as role
+  CommandTag  command;
+  bool        succeeded;
+  char        object[NAMEDATALEN];
+} audit_record;
+
+/**
+ * Set up the shared memory ring buffer and register the background worker
+ * that drains it. Must be called from _PG_init() before reserve_named_shmem(),
+ * auditing stays off unless supautils is in shared_preload_libraries.
+ */
+extern void init_audit(bool enabled);
+
+extern bool audit_enabled(void);
+
+/**
+ * The name of the first object `stmt` acts on, NULL when there's none.
+ */
+extern const char *statement_object(Node *stmt);
+
+/**
+ * Fill in the parts of the record known before `stmt` runs.
+ */
+extern void audit_start(audit_record *rec, Oid role, Node *stmt);
+
+/**
+ * Copy the record into the ring buffer and wake up the worker. Doesn't throw,
+ * so it can be called while handling an error.
+ */
+extern void audit_finish(audit_record *rec, Oid escalated_to, bool succeeded);
+
+PGDLLEXPORT void supautils_audit_main(Datum arg);
+
+#endif
@@ -0,0 +1,256 @@
+#include "pg_prelude.h"
+
+#include <math.h>
+
+#include "config_ceilings.h"
+#include "constrained_extensions.h"
+#include "memory.h"
+#include "stats.h"
+
+static JSON_ACTION_RETURN_TYPE json_array_start(void *state) {
+  json_config_ceilings_parse_state *parse = state;
+
+  parse->state     = JCC_UNEXPECTED_ARRAY;
+  parse->error_msg = "unexpected array";
+  JSON_ACTION_RETURN;
+}
+
+static JSON_ACTION_RETURN_TYPE json_object_start(void *state) {
+  json_config_ceilings_parse_state *parse = state;
+
+  switch (parse->state) {
+  case JCC_EXPECT_TOPLEVEL_START:
+    parse->state = JCC_EXPECT_TOPLEVEL_FIELD;
+    break;
+  case JCC_EXPECT_CEILING:
+    parse->error_msg = "unexpected object for the ceiling, expected a string";
+    parse->state     = JCC_UNEXPECTED_OBJECT;
+    break;
+  default: break;
+  }
+  JSON_ACTION_RETURN;
+}
+
+static JSON_ACTION_RETURN_TYPE
+json_object_field_start(void *state, char *fname,
+                        __attribute__((unused)) bool isnull) {
+  json_config_ceilings_parse_state *parse = state;
+  config_ceiling                   *x = &parse->ceilings[parse->total_ceilings];
+
+  switch (parse->state) {
+  case JCC_EXPECT_TOPLEVEL_FIELD:
+    if (parse->total_ceilings >= MAX_CONFIG_CEILINGS) {
+      parse->state     = JCC_TOO_MANY_CEILINGS;
+      parse->error_msg = "too many ceilings, the maximum is "
+                         CppAsString2(MAX_CONFIG_CEILINGS);
+      break;
+    }
+    x->name = MemoryContextStrdup(get_memory_context(MEMCXT_CONFIG_CEILINGS),
+                                  fname);
+    parse->state = JCC_EXPECT_CEILING;
+    break;
+  default: break;
+  }
+  pfree(fname);
+  JSON_ACTION_RETURN;
+}
+
+static JSON_ACTION_RETURN_TYPE json_scalar(void *state, char *token,
+                                           JsonTokenType tokentype) {
+  json_config_ceilings_parse_state *parse = state;
+  config_ceiling                   *x = &parse->ceilings[parse->total_ceilings];
+
+  switch (parse->state) {
+  case JCC_EXPECT_CEILING:
+    if (tokentype == JSON_TOKEN_STRING && token[0] != '\0') {
+      x->ceiling = MemoryContextStrdup(
+          get_memory_context(MEMCXT_CONFIG_CEILINGS), token);
+      parse->state = JCC_EXPECT_TOPLEVEL_FIELD;
+      (parse->total_ceilings)++;
+    } else {
+      parse->state     = JCC_UNEXPECTED_CEILING_VALUE;
+      parse->error_msg = "unexpected ceiling value, expected a string with "
+                         "a value or a percentage";
+    }
+    break;
+
+  case JCC_EXPECT_TOPLEVEL_START:
+    parse->state     = JCC_UNEXPECTED_SCALAR;
+    parse->error_msg = "unexpected scalar, expected an object";
+    break;
+
+  default: break;
+  }
+  pfree(token);
+  JSON_ACTION_RETURN;
+}
+
+json_config_ceilings_parse_state
+parse_config_ceilings(const char *str, config_ceiling *ceilings) {
+  JsonLexContext    *lex;
+  JsonParseErrorType json_error;
+  JsonSemAction      sem;
+  char              *json = pstrdup(str);
+
+  json_config_ceilings_parse_state state = {JCC_EXPECT_TOPLEVEL_START, NULL, 0,
+                                            ceilings};
+
+  lex = NEW_JSON_LEX_CONTEXT_CSTRING_LEN(json, strlen(json), PG_UTF8, true);
+
+  sem.semstate            = &state;
+  sem.object_start        = json_object_start;
+  sem.object_end          = NULL;
+  sem.array_start         = json_array_start;
+  sem.array_end           = NULL;
+  sem.object_field_start  = json_object_field_start;
+  sem.object_field_end    = NULL;
+  sem.array_element_start = NULL;
+  sem.array_element_end   = NULL;
+  sem.scalar              = json_scalar;
+
+  json_error = pg_parse_json(lex, &sem);
+
+  if (json_error != JSON_SUCCESS) state.error_msg = "invalid json";
+
+  FREE_JSON_LEX_CONTEXT(lex);
+  pfree(json);
+
+  return state;
+}
+
+#ifndef FRONTEND
+
+// integer parameters are tried first so their clamped value stays an integer
+static bool parse_number(const char *value, int flags, double *result,
+                         bool *is_int) {
+  int int_result;
+
+  *is_int = parse_int(value, &int_result, flags, NULL);
+  if (*is_int) {
+    *result = int_result;
+    return true;
+  }
+
+  return parse_real(value, result, flags, NULL);
+}
+
+static double memory_unit_bytes(int flags) {
+  switch (flags & GUC_UNIT_MEMORY) {
+  case GUC_UNIT_KB: return 1024.0;
+  case GUC_UNIT_MB: return 1024.0 * 1024.0;
+  case GUC_UNIT_BLOCKS: return BLCKSZ;
+  case GUC_UNIT_XBLOCKS: return XLOG_BLCKSZ;
+  default: return 1.0;
+  }
+}
+
+// The ceiling in the base unit of the parameter. Percentages are of the
+// memory for memory parameters and of the CPUs for the rest, returns false
+// when those can't be obtained.
+static bool ceiling_value(const config_ceiling *c, int flags, double *result) {
+  char  *end;
+  double percent = strtod(c->ceiling, &end);
+  bool   is_int;
+
+  if (end != c->ceiling && strcmp(end, "%") == 0) {
+    if (flags & GUC_UNIT_MEMORY) {
+      uint64 mem = system_memory();
+
+      if (mem == 0) return false;
+
+      *result = mem * percent / 100.0 / memory_unit_bytes(flags);
+    } else if (flags & GUC_UNIT_TIME) {
+      ereport(ERROR,
+              (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+               errmsg("supautils.privileged_role_config_ceilings: the ceiling "
+                      "of \"%s\" can't be a percentage, it's a time",
+                      c->name)));
+    } else {
+      int cpus = system_cpus();
+
+      if (cpus == 0) return false;
+
+      *result = cpus * percent / 100.0;
+    }
+
+    return true;
+  }
+
+  if (!parse_number(c->ceiling, flags, result, &is_int))
+    ereport(ERROR,
+            (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+             errmsg("supautils.privileged_role_config_ceilings: invalid "
+                    "ceiling \"%s\" for \"%s\"",
+                    c->ceiling, c->name)));
+
+  return true;
+}
+
+static Node *make_string_const(char *str) {
+  A_Const *n = makeNode(A_Const);
+
+#if PG15_GTE
+  n->val.sval.type = T_String;
+  n->val.sval.sval = str;
+#else
+  n->val.type    = T_String;
+  n->val.val.str = str;
+#endif
+  n->location = -1;
+
+  return (Node *)n;
+}
+
+List *apply_config_ceiling(VariableSetStmt      *stmt,
+                           const config_ceiling *ceilings,
+                           const size_t          total_ceilings,
+                           config_ceilings_mode  mode) {
+  const config_ceiling *c = NULL;
+  char                 *value;
+  int                   flags;
+  double                requested;
+  double                ceiling;
+  bool                  is_int;
+
+  if (stmt->kind != VAR_SET_VALUE) return NIL;
+
+  for (size_t i = 0; i < total_ceilings; i++)
+    if (strcmp(stmt->name, ceilings[i].name) == 0) c = &ceilings[i];
+
+  if (c == NULL) return NIL;
+
+  flags = GetConfigOptionFlags(stmt->name, true);
+  value = ExtractSetVariableArgs(stmt);
+
+  // not a number, an invalid value is reported when it's set
+  if (value == NULL || !parse_number(value, flags, &requested, &is_int))
+    return NIL;
+
+  if (!ceiling_value(c, flags, &ceiling)) return NIL;
+
+  // negative values usually mean no limit
+  if (requested >= 0 && requested <= ceiling) return NIL;
+
+  if (mode == CONFIG_CEILINGS_ERROR) {
+    stats_incr(STAT_CONFIG_CEILING_REJECTED);
+    ereport(ERROR,
+            (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+             errmsg("\"%s\" is above the ceiling of \"%s\"", value,
+                    stmt->name),
+             errdetail("The ceiling of \"%s\" is %s.", stmt->name,
+                       c->ceiling)));
+  }
+
+  stats_incr(STAT_CONFIG_CEILING_CLAMPED);
+  ereport(WARNING,
+          (errmsg("\"%s\" is above the ceiling of \"%s\", using the ceiling "
+                  "instead",
+                  value, stmt->name),
+           errdetail("The ceiling of \"%s\" is %s.", stmt->name, c->ceiling)));
+
+  // rounded down so the clamped value is never above the ceiling
+  return list_make1(make_string_const(
+      is_int ? psprintf("%.0f", floor(ceiling)) : psprintf("%.15g", ceiling)));
+}
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef CONFIG_CEILINGS_H
+#define CONFIG_CEILINGS_H
+
+#include "pg_prelude.h"
+
+#define MAX_CONFIG_CEILINGS 100
+
+typedef struct {
+  char *name;
+  // an absolute value in the parameter units (e.g. "1GB") or a percentage of
+  // the instance memory or CPUs (e.g. "25%")
+  char *ceiling;
+} config_ceiling;
+
+typedef enum {
+  CONFIG_CEILINGS_ERROR,
+  CONFIG_CEILINGS_CLAMP,
+} config_ceilings_mode;
+
+typedef enum {
+  JCC_EXPECT_TOPLEVEL_START,
+  JCC_EXPECT_TOPLEVEL_FIELD,
+  JCC_EXPECT_CEILING,
+  JCC_UNEXPECTED_ARRAY,
+  JCC_UNEXPECTED_SCALAR,
+  JCC_UNEXPECTED_OBJECT,
+  JCC_UNEXPECTED_CEILING_VALUE,
+  JCC_TOO_MANY_CEILINGS
+} json_config_ceilings_semantic_state;
+
+typedef struct {
+  json_config_ceilings_semantic_state state;
+  char                               *error_msg;
+  int                                 total_ceilings;
+  config_ceiling                     *ceilings;
+} json_config_ceilings_parse_state;
+
+extern json_config_ceilings_parse_state
+parse_config_ceilings(const char *str, config_ceiling *ceilings);
+
+#ifndef FRONTEND
+
+/**
+ * Check the value of a SET statement against the parameter's ceiling, either
+ * rejecting it or clamping it to the ceiling depending on `mode`. Returns the
+ * args of the clamped value, NIL when it's kept. The statement is left as is,
+ * it may be in the plan cache.
+ */
+extern List *apply_config_ceiling(VariableSetStmt      *stmt,
+                                  const config_ceiling *ceilings,
+                                  const size_t          total_ceilings,
+                                  config_ceilings_mode  mode);
+
+#endif
+
+#endif
@@ -3,11 +3,85 @@
 #ifdef __linux__
 #  include <sys/sysinfo.h>
 #endif
+#include <ctype.h>
 #include <errno.h>
 #include <sys/statvfs.h>
 
 #include "constrained_extensions.h"
-#include "utils.h"
+#include "memory.h"
+#include "stats.h"
+#include "wait_events.h"
+
+#ifdef FRONTEND
+
+// pg_size_bytes() is only in the backend, the same units are accepted here
+static bool size_bytes(const char *str, uint64 *result) {
+  static const struct {
+    const char *unit;
+    double      multiplier;
+  } units[] = {
+    {"bytes", 1.0},
+    {"B", 1.0},
+    {"kB", 1024.0},
+    {"MB", 1024.0 * 1024.0},
+    {"GB", 1024.0 * 1024.0 * 1024.0},
+    {"TB", 1024.0 * 1024.0 * 1024.0 * 1024.0},
+    {"PB", 1024.0 * 1024.0 * 1024.0 * 1024.0 * 1024.0},
+  };
+  char  *end;
+  double size = strtod(str, &end);
+  size_t unit_len;
+
+  if (end == str || size < 0) return false;
+
+  while (isspace((unsigned char)*end))
+    end++;
+
+  unit_len = strlen(end);
+  while (unit_len > 0 && isspace((unsigned char)end[unit_len - 1]))
+    unit_len--;
+
+  if (unit_len == 0) {
+    *result = (uint64)size;
+    return true;
+  }
+
+  for (size_t i = 0; i < lengthof(units); i++) {
+    if (strlen(units[i].unit) == unit_len &&
+        pg_strncasecmp(end, units[i].unit, unit_len) == 0) {
+      *result = (uint64)(size * units[i].multiplier);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+#else
+
+// pg_size_bytes() errors out on an invalid size
+static bool size_bytes(const char *str, uint64 *result) {
+  *result = DatumGetInt64(
+      DirectFunctionCall1(pg_size_bytes, CStringGetTextDatum(str)));
+  return true;
+}
+
+#endif
+
+// the whole number token must be a positive integer, e.g. not 1.5 or 1e9
+static bool positive_int(const char *str, int *result) {
+  char *end;
+  long  val;
+
+  errno = 0;
+  val   = strtol(str, &end, 10);
+
+  if (errno != 0 || end == str || *end != '\0' || val <= 0 || val > INT_MAX)
+    return false;
+
+  *result = (int)val;
+  return true;
+}
 
 static JSON_ACTION_RETURN_TYPE json_array_start(void *state) {
   json_constrained_extension_parse_state *parse = state;
@@ -27,8 +101,9 @@ static JSON_ACTION_RETURN_TYPE json_object_start(void *state) {
   case JCE_EXPECT_CPU:
   case JCE_EXPECT_MEM:
   case JCE_EXPECT_DISK:
-    parse->error_msg =
-        "unexpected object for cpu, mem or disk, expected a value";
+  case JCE_EXPECT_CONCURRENCY:
+    parse->error_msg = "unexpected object for cpu, mem, disk or concurrency, "
+                       "expected a value";
     parse->state = JCE_UNEXPECTED_OBJECT;
     break;
   default: break;
@@ -57,7 +132,14 @@ json_object_field_start(void *state, char *fname,
 
   switch (parse->state) {
   case JCE_EXPECT_TOPLEVEL_FIELD:
-    x->name      = MemoryContextStrdup(TopMemoryContext, fname);
+    if (parse->total_cexts >= MAX_CONSTRAINED_EXTENSIONS) {
+      parse->state     = JCE_TOO_MANY_EXTENSIONS;
+      parse->error_msg = "too many extensions, the maximum is "
+                         CppAsString2(MAX_CONSTRAINED_EXTENSIONS);
+      break;
+    }
+    x->name      = MemoryContextStrdup(
+        get_memory_context(MEMCXT_CONSTRAINED_EXTENSIONS), fname);
     parse->state = JCE_EXPECT_CONSTRAINTS_START;
     break;
 
@@ -68,14 +150,18 @@ json_object_field_start(void *state, char *fname,
       parse->state = JCE_EXPECT_MEM;
     else if (strcmp(fname, "disk") == 0)
       parse->state = JCE_EXPECT_DISK;
+    else if (strcmp(fname, "concurrency") == 0)
+      parse->state = JCE_EXPECT_CONCURRENCY;
     else {
       parse->state     = JCE_UNEXPECTED_FIELD;
-      parse->error_msg = "unexpected field, only cpu, mem or disk are allowed";
+      parse->error_msg = "unexpected field, only cpu, mem, disk or "
+                         "concurrency are allowed";
     }
     break;
 
   default: break;
   }
+  pfree(fname);
   JSON_ACTION_RETURN;
 }
 
@@ -96,9 +182,7 @@ static JSON_ACTION_RETURN_TYPE json_scalar(void *state, char *token,
     break;
 
   case JCE_EXPECT_MEM:
-    if (tokentype == JSON_TOKEN_STRING) {
-      x->mem = DatumGetInt64(
-          DirectFunctionCall1(pg_size_bytes, CStringGetTextDatum(token)));
+    if (tokentype == JSON_TOKEN_STRING && size_bytes(token, &x->mem)) {
       parse->state = JCE_EXPECT_CONSTRAINTS_START;
     } else {
       parse->state     = JCE_UNEXPECTED_MEM_VALUE;
@@ -109,9 +193,7 @@ static JSON_ACTION_RETURN_TYPE json_scalar(void *state, char *token,
     break;
 
   case JCE_EXPECT_DISK:
-    if (tokentype == JSON_TOKEN_STRING) {
-      x->disk = DatumGetInt64(
-          DirectFunctionCall1(pg_size_bytes, CStringGetTextDatum(token)));
+    if (tokentype == JSON_TOKEN_STRING && size_bytes(token, &x->disk)) {
       parse->state = JCE_EXPECT_CONSTRAINTS_START;
     } else {
       parse->state     = JCE_UNEXPECTED_DISK_VALUE;
@@ -121,6 +203,17 @@ static JSON_ACTION_RETURN_TYPE json_scalar(void *state, char *token,
     }
     break;
 
+  case JCE_EXPECT_CONCURRENCY:
+    if (tokentype == JSON_TOKEN_NUMBER &&
+        positive_int(token, &x->concurrency)) {
+      parse->state = JCE_EXPECT_CONSTRAINTS_START;
+    } else {
+      parse->state     = JCE_UNEXPECTED_CONCURRENCY_VALUE;
+      parse->error_msg = "unexpected concurrency value, expected a positive "
+                         "integer";
+    }
+    break;
+
   case JCE_EXPECT_TOPLEVEL_START:
     parse->state     = JCE_UNEXPECTED_SCALAR;
     parse->error_msg = "unexpected scalar, expected an object";
@@ -133,6 +226,7 @@ static JSON_ACTION_RETURN_TYPE json_scalar(void *state, char *token,
 
   default: break;
   }
+  pfree(token);
   JSON_ACTION_RETURN;
 }
 
@@ -141,12 +235,12 @@ parse_constrained_extensions(const char *str, constrained_extension *cexts) {
   JsonLexContext    *lex;
   JsonParseErrorType json_error;
   JsonSemAction      sem;
+  char              *json = pstrdup(str);
 
   json_constrained_extension_parse_state state = {JCE_EXPECT_TOPLEVEL_START,
                                                   NULL, 0, cexts};
 
-  lex = NEW_JSON_LEX_CONTEXT_CSTRING_LEN(pstrdup(str), strlen(str), PG_UTF8,
-                                         true);
+  lex = NEW_JSON_LEX_CONTEXT_CSTRING_LEN(json, strlen(json), PG_UTF8, true);
 
   sem.semstate            = &state;
   sem.object_start        = json_object_start;
@@ -163,9 +257,14 @@ parse_constrained_extensions(const char *str, constrained_extension *cexts) {
 
   if (json_error != JSON_SUCCESS) state.error_msg = "invalid json";
 
+  FREE_JSON_LEX_CONTEXT(lex);
+  pfree(json);
+
   return state;
 }
 
+#ifndef FRONTEND
+
 #define ERROR_HINT "upgrade to an instance with higher resources"
 
 // implementation is Linux specific
@@ -179,6 +278,8 @@ void constrain_extension(const char *name, constrained_extension *cexts,
 #endif
   struct statvfs fsdata = {};
 
+  supautils_wait_start(WAIT_EVENT_SYSTEM_RESOURCES);
+
 #ifdef __linux__
   if (sysinfo(&info) < 0) {
     int save_errno = errno;
@@ -191,16 +292,21 @@ void constrain_extension(const char *name, constrained_extension *cexts,
     ereport(ERROR, errmsg("statvfs call failed: %s", strerror(save_errno)));
   }
 
+  pgstat_report_wait_end();
+
   for (size_t i = 0; i < total_cexts; i++) {
     if (strcmp(name, cexts[i].name) == 0) {
 #ifdef __linux__
-      if (cexts[i].cpu != 0 && cexts[i].cpu > get_nprocs())
+      if (cexts[i].cpu != 0 && cexts[i].cpu > get_nprocs()) {
+        stats_incr(STAT_EXT_CONSTRAINT_REJECTED);
         ereport(ERROR, errdetail("required CPUs: %d", cexts[i].cpu),
                 errhint(ERROR_HINT),
                 errmsg("not enough CPUs for using this extension"));
+      }
       if (cexts[i].mem != 0 && cexts[i].mem > info.totalram) {
         char *pretty_size = text_to_cstring(DatumGetTextPP(
             DirectFunctionCall1(pg_size_pretty, Int64GetDatum(cexts[i].mem))));
+        stats_incr(STAT_EXT_CONSTRAINT_REJECTED);
         ereport(ERROR, errdetail("required memory: %s", pretty_size),
                 errhint(ERROR_HINT),
                 errmsg("not enough memory for using this extension"));
@@ -210,6 +316,7 @@ void constrain_extension(const char *name, constrained_extension *cexts,
           cexts[i].disk > (size_t)(fsdata.f_bfree * fsdata.f_bsize)) {
         char *pretty_size = text_to_cstring(DatumGetTextPP(
             DirectFunctionCall1(pg_size_pretty, Int64GetDatum(cexts[i].disk))));
+        stats_incr(STAT_EXT_CONSTRAINT_REJECTED);
         ereport(ERROR, errdetail("required free disk space: %s", pretty_size),
                 errhint(ERROR_HINT),
                 errmsg("not enough free disk space for using this extension"));
@@ -217,3 +324,34 @@ void constrain_extension(const char *name, constrained_extension *cexts,
     }
   }
 }
+
+constrained_extension *
+find_constrained_extension(const char *name, constrained_extension *cexts,
+                           const size_t total_cexts) {
+  for (size_t i = 0; i < total_cexts; i++)
+    if (strcmp(name, cexts[i].name) == 0) return &cexts[i];
+
+  return NULL;
+}
+
+int system_cpus(void) {
+#ifdef __linux__
+  return get_nprocs();
+#else
+  return 0;
+#endif
+}
+
+uint64 system_memory(void) {
+#ifdef __linux__
+  struct sysinfo info = {};
+
+  if (sysinfo(&info) < 0) return 0;
+
+  return (uint64)info.totalram * info.mem_unit;
+#else
+  return 0;
+#endif
+}
+
+#endif
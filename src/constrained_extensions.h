@@ -1,13 +1,16 @@
 #ifndef CONSTRAINED_EXTENSIONS_H
 #define CONSTRAINED_EXTENSIONS_H
 
-#include <postgres.h>
+#include "pg_prelude.h"
+
+#define MAX_CONSTRAINED_EXTENSIONS 100
 
 typedef struct {
   char  *name;
   int    cpu;
   uint64 mem;
   uint64 disk;
+  int    concurrency; // max statements running at once, 0 for no limit
 } constrained_extension;
 
 typedef enum {
@@ -17,13 +20,16 @@ typedef enum {
   JCE_EXPECT_CPU,
   JCE_EXPECT_MEM,
   JCE_EXPECT_DISK,
+  JCE_EXPECT_CONCURRENCY,
   JCE_UNEXPECTED_FIELD,
   JCE_UNEXPECTED_ARRAY,
   JCE_UNEXPECTED_SCALAR,
   JCE_UNEXPECTED_OBJECT,
   JCE_UNEXPECTED_CPU_VALUE,
   JCE_UNEXPECTED_MEM_VALUE,
-  JCE_UNEXPECTED_DISK_VALUE
+  JCE_UNEXPECTED_DISK_VALUE,
+  JCE_UNEXPECTED_CONCURRENCY_VALUE,
+  JCE_TOO_MANY_EXTENSIONS
 } json_constrained_extension_semantic_state;
 
 typedef struct {
@@ -36,7 +42,27 @@ typedef struct {
 extern json_constrained_extension_parse_state
 parse_constrained_extensions(const char *str, constrained_extension *cexts);
 
+#ifndef FRONTEND
+
 void constrain_extension(const char *name, constrained_extension *cexts,
                          const size_t total_cexts);
 
+/**
+ * The CPUs and total memory of the instance, 0 when they can't be obtained
+ * (only Linux is supported).
+ */
+extern int system_cpus(void);
+
+extern uint64 system_memory(void);
+
+/**
+ * Returns the constrained extension named `name`, NULL if it's not
+ * constrained.
+ */
+extern constrained_extension *
+find_constrained_extension(const char *name, constrained_extension *cexts,
+                           const size_t total_cexts);
+
+#endif
+
 #endif
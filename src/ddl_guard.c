@@ -0,0 +1,268 @@
+#include "pg_prelude.h"
+
+#include "ddl_guard.h"
+#include "explain.h"
+#include "stats.h"
+
+#if PG16_GTE
+#  define owns_relation(relid)                                                 \
+    object_ownercheck(RelationRelationId, relid, GetUserId())
+#else
+#  define owns_relation(relid) pg_class_ownercheck(relid, GetUserId())
+#endif
+
+// A constant default is stored in the catalog, anything else may be volatile
+// and filled in by rewriting the table. Stable defaults like now() don't
+// rewrite either but they can't be told apart from the volatile ones before
+// the statement is analyzed.
+static bool is_constant(Node *expr) {
+  while (IsA(expr, TypeCast))
+    expr = ((TypeCast *)expr)->arg;
+
+  return IsA(expr, A_Const);
+}
+
+static bool column_def_rewrites(ColumnDef *def) {
+  ListCell *lc;
+
+  foreach (lc, def->constraints) {
+    Constraint *con = lfirst_node(Constraint, lc);
+
+    switch (con->contype) {
+    case CONSTR_IDENTITY: return true;
+    case CONSTR_GENERATED:
+#if PG18_GTE
+      // virtual columns are computed on read
+      if (con->generated_kind == ATTRIBUTE_GENERATED_VIRTUAL) break;
+#endif
+      return true;
+    case CONSTR_DEFAULT:
+      if (!is_constant(con->raw_expr)) return true;
+      break;
+    default: break;
+    }
+  }
+
+  return false;
+}
+
+static bool alter_table_cmd_rewrites(AlterTableCmd *cmd) {
+  switch (cmd->subtype) {
+  case AT_AlterColumnType:
+  case AT_SetTableSpace:
+  case AT_SetLogged:
+  case AT_SetUnLogged:
+#if PG15_GTE
+  case AT_SetAccessMethod:
+#endif
+    return true;
+  case AT_AddColumn: return column_def_rewrites(castNode(ColumnDef, cmd->def));
+  default: return false;
+  }
+}
+
+// USING INDEX attaches an index that was already built, e.g. CONCURRENTLY
+static bool constraint_builds_index(Constraint *con) {
+  switch (con->contype) {
+  case CONSTR_PRIMARY:
+  case CONSTR_UNIQUE:
+  case CONSTR_EXCLUSION: return con->indexname == NULL;
+  default: return false;
+  }
+}
+
+static bool alter_table_cmd_builds_index(AlterTableCmd *cmd) {
+  ListCell *lc;
+
+  switch (cmd->subtype) {
+  case AT_AddIndex:
+    return !OidIsValid(castNode(IndexStmt, cmd->def)->indexOid);
+  case AT_AddConstraint:
+    return constraint_builds_index(castNode(Constraint, cmd->def));
+  case AT_AddColumn:
+    foreach (lc, castNode(ColumnDef, cmd->def)->constraints)
+      if (constraint_builds_index(lfirst_node(Constraint, lc))) return true;
+    return false;
+  default: return false;
+  }
+}
+
+// Locks the relation with the lock the statement takes anyway, so it's not
+// upgraded later. Returns InvalidOid when the relation is missing or not owned,
+// without locking it.
+static Oid lock_owned_relation(RangeVar *rv, LOCKMODE lockmode) {
+  Oid relid = RangeVarGetRelid(rv, NoLock, true);
+
+  if (!OidIsValid(relid) || !owns_relation(relid)) return InvalidOid;
+
+  LockRelationOid(relid, lockmode);
+
+  return relid;
+}
+
+// the blocks of the relation and, when the statement recurses, of its
+// partitions or inheritance children
+static uint64 relation_blocks(Oid relid, LOCKMODE lockmode, bool recurse) {
+  List     *relids = recurse ? find_all_inheritors(relid, lockmode, NULL)
+                             : list_make1_oid(relid);
+  uint64    total  = 0;
+  ListCell *lc;
+
+  foreach (lc, relids) {
+    Relation rel = try_relation_open(lfirst_oid(lc), NoLock);
+
+    // dropped before it was locked
+    if (rel == NULL) continue;
+
+    if (RELKIND_HAS_STORAGE(rel->rd_rel->relkind))
+      total += RelationGetNumberOfBlocks(rel);
+
+    relation_close(rel, NoLock);
+  }
+
+  return total;
+}
+
+static char *pretty_blocks(uint64 blocks) {
+  return text_to_cstring(DatumGetTextPP(DirectFunctionCall1(
+      pg_size_pretty, Int64GetDatum((int64)(blocks * BLCKSZ)))));
+}
+
+// An explained statement measures its relation like pg_relation_size(), with a
+// lock that doesn't block writes instead of the lock of the statement
+static LOCKMODE guard_lockmode(stmt_context *ctx, LOCKMODE lockmode) {
+  return stmt_is_explained(ctx) ? AccessShareLock : lockmode;
+}
+
+static void report_guarded(const char *command, const char *relname,
+                           uint64 blocks, ddl_guard_mode mode, int max_blocks,
+                           const char *hint, stmt_context *ctx) {
+  if (stmt_is_explained(ctx))
+    trace_check(ctx, "ddl_guard", relname, pretty_blocks(blocks));
+
+  if (blocks <= (uint64)max_blocks) return;
+
+  stats_incr(mode == DDL_GUARD_ERROR ? STAT_DDL_GUARD_REJECTED
+                                     : STAT_DDL_GUARD_WARNED);
+  ereport(mode == DDL_GUARD_ERROR ? ERROR : WARNING,
+          (errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+           errmsg("%s on \"%s\" blocks writes to it until it finishes, only "
+                  "superusers can run it on relations larger than %s",
+                  command, relname, pretty_blocks(max_blocks)),
+           errdetail("\"%s\" is %s.", relname, pretty_blocks(blocks)),
+           hint != NULL ? errhint("%s", hint) : 0));
+}
+
+void guard_alter_table(AlterTableStmt *stmt, ddl_guard_mode mode,
+                       int max_blocks, stmt_context *ctx) {
+  bool      rewrites     = false;
+  bool      builds_index = false;
+  bool      recurse;
+  LOCKMODE  lockmode;
+  Oid       relid;
+  ListCell *lc;
+
+  if (mode == DDL_GUARD_OFF) return;
+
+  foreach (lc, stmt->cmds) {
+    AlterTableCmd *cmd = lfirst_node(AlterTableCmd, lc);
+
+    rewrites     |= alter_table_cmd_rewrites(cmd);
+    builds_index |= alter_table_cmd_builds_index(cmd);
+  }
+
+  if (!rewrites && !builds_index) return;
+
+  lockmode = guard_lockmode(ctx, AlterTableGetLockLevel(stmt->cmds));
+  relid    = lock_owned_relation(stmt->relation, lockmode);
+
+  if (!OidIsValid(relid)) return;
+
+  // like CREATE INDEX, the children of a plain inheritance don't get the index
+  recurse = stmt->relation->inh &&
+            (rewrites || get_rel_relkind(relid) == RELKIND_PARTITIONED_TABLE);
+
+  report_guarded("ALTER TABLE", stmt->relation->relname,
+                 relation_blocks(relid, lockmode, recurse), mode, max_blocks,
+                 rewrites ? NULL
+                          : "Create the index CONCURRENTLY, then ADD "
+                            "CONSTRAINT ... USING INDEX.",
+                 ctx);
+}
+
+void guard_index(IndexStmt *stmt, ddl_guard_mode mode, int max_blocks,
+                 stmt_context *ctx) {
+  LOCKMODE lockmode = guard_lockmode(ctx, ShareLock);
+  Oid      relid;
+
+  if (mode == DDL_GUARD_OFF || stmt->concurrent) return;
+
+  relid = lock_owned_relation(stmt->relation, lockmode);
+
+  if (!OidIsValid(relid)) return;
+
+  // unlike ALTER TABLE, only the partitions get the index, not the children
+  // of a plain inheritance
+  report_guarded("CREATE INDEX", stmt->relation->relname,
+                 relation_blocks(relid, lockmode,
+                                 stmt->relation->inh &&
+                                     get_rel_relkind(relid) ==
+                                         RELKIND_PARTITIONED_TABLE),
+                 mode, max_blocks, "Use CREATE INDEX CONCURRENTLY instead.",
+                 ctx);
+}
+
+static bool is_concurrent_reindex(ReindexStmt *stmt) {
+#if PG14_GTE
+  ListCell *lc;
+
+  foreach (lc, stmt->params) {
+    DefElem *opt = lfirst_node(DefElem, lc);
+
+    if (strcmp(opt->defname, "concurrently") == 0) return defGetBoolean(opt);
+  }
+
+  return false;
+#else
+  return stmt->concurrent;
+#endif
+}
+
+void guard_reindex(ReindexStmt *stmt, ddl_guard_mode mode, int max_blocks,
+                   stmt_context *ctx) {
+  Oid  relid;
+  Oid  heapid;
+  char relkind;
+
+  if (mode == DDL_GUARD_OFF || is_concurrent_reindex(stmt)) return;
+
+  // REINDEX SCHEMA, DATABASE and SYSTEM take their locks one table at a time
+  if (stmt->kind != REINDEX_OBJECT_INDEX && stmt->kind != REINDEX_OBJECT_TABLE)
+    return;
+
+  relid   = RangeVarGetRelid(stmt->relation, NoLock, true);
+  relkind = get_rel_relkind(relid);
+
+  // partitions are reindexed one per transaction
+  if (!OidIsValid(relid) || relkind == RELKIND_PARTITIONED_TABLE ||
+      relkind == RELKIND_PARTITIONED_INDEX)
+    return;
+
+  heapid = stmt->kind == REINDEX_OBJECT_INDEX ? IndexGetRelation(relid, true)
+                                              : relid;
+
+  if (!OidIsValid(heapid) || !owns_relation(heapid)) return;
+
+  // in the same order as REINDEX, the table first
+  LockRelationOid(heapid, guard_lockmode(ctx, ShareLock));
+  if (relid != heapid)
+    LockRelationOid(relid, guard_lockmode(ctx, AccessExclusiveLock));
+
+  // rebuilding an index scans its table, so even a small index of a large
+  // table blocks writes for long
+  report_guarded("REINDEX",
+                 relid == heapid ? stmt->relation->relname
+                                 : get_rel_name(heapid),
+                 relation_blocks(heapid, NoLock, false), mode, max_blocks,
+                 "Use REINDEX CONCURRENTLY instead.", ctx);
+}
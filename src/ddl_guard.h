@@ -0,0 +1,32 @@
+#ifndef DDL_GUARD_H
+#define DDL_GUARD_H
+
+#include "pg_prelude.h"
+#include "utils.h"
+
+typedef enum {
+  DDL_GUARD_OFF,
+  DDL_GUARD_WARN,
+  DDL_GUARD_ERROR
+} ddl_guard_mode;
+
+/**
+ * Reject or warn on statements that may hold a lock blocking writes on a
+ * relation larger than `max_blocks` for the whole time they run: ALTER TABLE
+ * subcommands that may rewrite the table or that build an index, CREATE INDEX
+ * and REINDEX without CONCURRENTLY.
+ *
+ * Relations the current user doesn't own are skipped, the statement fails its
+ * own permission checks before taking any lock. An explained statement only
+ * reports the size of its relation, without taking the lock of the statement.
+ */
+extern void guard_alter_table(AlterTableStmt *stmt, ddl_guard_mode mode,
+                              int max_blocks, stmt_context *ctx);
+
+extern void guard_index(IndexStmt *stmt, ddl_guard_mode mode, int max_blocks,
+                        stmt_context *ctx);
+
+extern void guard_reindex(ReindexStmt *stmt, ddl_guard_mode mode,
+                          int max_blocks, stmt_context *ctx);
+
+#endif
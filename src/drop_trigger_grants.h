@@ -1,6 +1,13 @@
 #ifndef DROP_TRIGGER_GRANTS_H
 #define DROP_TRIGGER_GRANTS_H
 
+#include "pg_prelude.h"
+
+#ifndef FRONTEND
+#  include "utils.h"
+#endif
+
+#define MAX_DROP_TRIGGER_GRANTS 100
 #define MAX_DROP_TRIGGER_GRANT_TABLES 100
 
 typedef struct {
@@ -17,7 +24,9 @@ typedef enum {
   JDTG_UNEXPECTED_ARRAY,
   JDTG_UNEXPECTED_SCALAR,
   JDTG_UNEXPECTED_OBJECT,
-  JDTG_UNEXPECTED_TABLE_VALUE
+  JDTG_UNEXPECTED_TABLE_VALUE,
+  JDTG_TOO_MANY_ROLES,
+  JDTG_TOO_MANY_TABLES
 } json_drop_trigger_grants_semantic_state;
 
 typedef struct {
@@ -30,9 +39,15 @@ typedef struct {
 extern json_drop_trigger_grants_parse_state
 parse_drop_trigger_grants(const char *str, drop_trigger_grants *dtgs);
 
+#ifndef FRONTEND
+
 extern bool
 is_current_role_granted_table_drop_trigger(const RangeVar *table_range_var,
+                                           stmt_context   *ctx,
                                            const drop_trigger_grants *dtgs,
-                                           const size_t total_dtgs);
+                                           const size_t total_dtgs,
+                                           LOCKMODE     lockmode);
+
+#endif
 
 #endif
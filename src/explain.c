@@ -0,0 +1,43 @@
+#include "pg_prelude.h"
+
+#include "explain.h"
+#include "hook_latency.h"
+
+void trace_check(stmt_context *ctx, const char *check, const char *object,
+                 const char *result) {
+  explain_trace *trace = ctx->trace;
+  Datum          values[4];
+  bool           nulls[4] = {0};
+  instr_time     elapsed;
+  ResourceOwner  oldowner;
+
+  if (trace == NULL) return;
+
+  INSTR_TIME_SET_CURRENT(elapsed);
+  INSTR_TIME_SUBTRACT(elapsed, trace->last);
+
+  values[0] = CStringGetTextDatum(check);
+  if (object != NULL)
+    values[1] = CStringGetTextDatum(object);
+  else
+    nulls[1] = true;
+  values[2] = CStringGetTextDatum(result);
+  values[3] = Int64GetDatum((int64)INSTR_TIME_GET_NS(elapsed));
+
+  // a spilled tuplestore must outlive the subtransaction, like in plpgsql
+  oldowner             = CurrentResourceOwner;
+  CurrentResourceOwner = trace->owner;
+  tuplestore_putvalues(trace->rsinfo->setResult, trace->rsinfo->setDesc,
+                       values, nulls);
+  CurrentResourceOwner = oldowner;
+
+  INSTR_TIME_SET_CURRENT(trace->last);
+}
+
+bool trace_decision(stmt_context *ctx, const char *decision) {
+  if (ctx->trace == NULL) return false;
+
+  ctx->trace->decision = decision;
+
+  return true;
+}
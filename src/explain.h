@@ -0,0 +1,39 @@
+#ifndef EXPLAIN_H
+#define EXPLAIN_H
+
+#include "pg_prelude.h"
+
+#include "utils.h"
+
+/**
+ * The rows of supautils_explain(). An explained statement goes through the
+ * utility handlers as usual, they record their checks here and stop where they
+ * would run the statement.
+ */
+struct explain_trace {
+  ReturnSetInfo *rsinfo;
+  // the owner of the tuplestore, the handlers run in a subtransaction
+  ResourceOwner owner;
+  instr_time    last;
+  // "escalate" or "chain", set where the statement would have run
+  const char *decision;
+};
+
+/**
+ * Record a check of an explained statement, timed from the previous one. Does
+ * nothing unless the statement is explained.
+ */
+extern void trace_check(stmt_context *ctx, const char *check,
+                        const char *object, const char *result);
+
+/**
+ * Record how an explained statement would run. Returns whether it's explained,
+ * then the caller must stop before running it.
+ */
+extern bool trace_decision(stmt_context *ctx, const char *decision);
+
+static inline const char *trace_bool(bool value) {
+  return value ? "true" : "false";
+}
+
+#endif
@@ -1,4 +1,11 @@
+#include "pg_prelude.h"
+
+#include <sys/stat.h>
+
+#include "explain.h"
 #include "extension_custom_scripts.h"
+#include "probes.h"
+#include "stats.h"
 
 // Prevent recursively running custom scripts
 static bool running_custom_script = false;
@@ -12,9 +19,25 @@ static char *sql_literal(const char *str) {
              quote_literal_cstr(quote_literal_cstr(str));
 }
 
-static void run_custom_script(const char *filename, const char *extname,
-                              const char *extschema, const char *extversion,
-                              bool extcascade) {
+// `script` is relative to the custom scripts path, an explained statement only
+// looks it up
+static void run_custom_script(const char *scripts_path, const char *script,
+                              const char *extname, const char *extschema,
+                              const char *extversion, bool extcascade,
+                              stmt_context *ctx) {
+  char filename[MAXPGPATH];
+
+  snprintf(filename, MAXPGPATH, "%s/%s", scripts_path, script);
+
+  if (stmt_is_explained(ctx)) {
+    struct stat st;
+
+    // the scripts run as supautils.superuser, for every extension
+    trace_check(ctx, "custom_script", script,
+                stat(filename, &st) == 0 ? "escalate" : "missing");
+    return;
+  }
+
   if (running_custom_script) {
     return;
   }
@@ -47,6 +70,8 @@ static void run_custom_script(const char *filename, const char *extname,
            sql_literal(extname), sql_literal(extschema),
            sql_literal(extversion), extcascade ? "'true'" : "'false'");
 
+  TRACE_SUPAUTILS_CUSTOM_SCRIPT_START(GetUserId(), extname, filename);
+
   PushActiveSnapshot(GetTransactionSnapshot());
   SPI_connect();
 
@@ -56,16 +81,19 @@ static void run_custom_script(const char *filename, const char *extname,
   }
   SPI_finish();
   PopActiveSnapshot();
+
+  TRACE_SUPAUTILS_CUSTOM_SCRIPT_DONE(GetUserId(), extname, filename);
   running_custom_script = false;
+
+  stats_incr(STAT_EXT_CUSTOM_SCRIPT_EXECUTED);
 }
 
 void run_global_before_create_script(
     char *extname, List *options,
-    const char *privileged_extensions_custom_scripts_path) {
+    const char *privileged_extensions_custom_scripts_path, stmt_context *ctx) {
   DefElem *d_schema = NULL, *d_new_version = NULL, *d_cascade = NULL;
   char    *extschema = NULL, *extversion = NULL;
   bool     extcascade = false;
-  char     filename[MAXPGPATH];
 
   ListCell *option_cell = NULL;
 
@@ -84,14 +112,14 @@ void run_global_before_create_script(
     }
   }
 
-  snprintf(filename, MAXPGPATH, "%s/before-create.sql",
-           privileged_extensions_custom_scripts_path);
-  run_custom_script(filename, extname, extschema, extversion, extcascade);
+  run_custom_script(privileged_extensions_custom_scripts_path,
+                    "before-create.sql", extname, extschema, extversion,
+                    extcascade, ctx);
 }
 
 void run_ext_before_create_script(
     char *extname, List *options,
-    const char *privileged_extensions_custom_scripts_path) {
+    const char *privileged_extensions_custom_scripts_path, stmt_context *ctx) {
   DefElem  *d_schema      = NULL;
   DefElem  *d_new_version = NULL;
   DefElem  *d_cascade     = NULL;
@@ -99,7 +127,7 @@ void run_ext_before_create_script(
   char     *extversion    = NULL;
   bool      extcascade    = false;
   ListCell *option_cell   = NULL;
-  char      filename[MAXPGPATH];
+  char      script[MAXPGPATH];
 
   foreach (option_cell, options) {
     DefElem *defel = lfirst_node(DefElem, option_cell);
@@ -116,14 +144,14 @@ void run_ext_before_create_script(
     }
   }
 
-  snprintf(filename, MAXPGPATH, "%s/%s/before-create.sql",
-           privileged_extensions_custom_scripts_path, extname);
-  run_custom_script(filename, extname, extschema, extversion, extcascade);
+  snprintf(script, MAXPGPATH, "%s/before-create.sql", extname);
+  run_custom_script(privileged_extensions_custom_scripts_path, script, extname,
+                    extschema, extversion, extcascade, ctx);
 }
 
 void run_ext_after_create_script(
     char *extname, List *options,
-    const char *privileged_extensions_custom_scripts_path) {
+    const char *privileged_extensions_custom_scripts_path, stmt_context *ctx) {
   DefElem  *d_schema      = NULL;
   DefElem  *d_new_version = NULL;
   DefElem  *d_cascade     = NULL;
@@ -131,7 +159,7 @@ void run_ext_after_create_script(
   char     *extversion    = NULL;
   bool      extcascade    = false;
   ListCell *option_cell   = NULL;
-  char      filename[MAXPGPATH];
+  char      script[MAXPGPATH];
 
   foreach (option_cell, options) {
     DefElem *defel = lfirst_node(DefElem, option_cell);
@@ -148,7 +176,7 @@ void run_ext_after_create_script(
     }
   }
 
-  snprintf(filename, MAXPGPATH, "%s/%s/after-create.sql",
-           privileged_extensions_custom_scripts_path, extname);
-  run_custom_script(filename, extname, extschema, extversion, extcascade);
+  snprintf(script, MAXPGPATH, "%s/after-create.sql", extname);
+  run_custom_script(privileged_extensions_custom_scripts_path, script, extname,
+                    extschema, extversion, extcascade, ctx);
 }
@@ -2,17 +2,18 @@
 #define EXTENSION_CUSTOM_SCRIPTS_H
 
 #include "pg_prelude.h"
+#include "utils.h"
 
 extern void run_global_before_create_script(
     char *extname, List *options,
-    const char *privileged_extensions_custom_scripts_path);
+    const char *privileged_extensions_custom_scripts_path, stmt_context *ctx);
 
 extern void run_ext_before_create_script(
     char *extname, List *options,
-    const char *privileged_extensions_custom_scripts_path);
+    const char *privileged_extensions_custom_scripts_path, stmt_context *ctx);
 
 extern void run_ext_after_create_script(
     char *extname, List *options,
-    const char *privileged_extensions_custom_scripts_path);
+    const char *privileged_extensions_custom_scripts_path, stmt_context *ctx);
 
 #endif
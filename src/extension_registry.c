@@ -0,0 +1,413 @@
+#include "pg_prelude.h"
+
+#ifdef __linux__
+#  include <sys/inotify.h>
+#endif
+#include <errno.h>
+#include <unistd.h>
+
+#include "extension_registry.h"
+#include "shmem.h"
+
+// with more extensions the registry stays unavailable, lookups fall back to
+// pg_available_extensions
+#define REGISTRY_MAX_EXTENSIONS 1024
+
+// without inotify, the extension directory is scanned again on this interval
+#define REGISTRY_RESCAN_INTERVAL_MS 60000
+
+// a package manager writes several files per extension, the directory is
+// scanned once it's done
+#define REGISTRY_SETTLE_MS 100
+
+// readers that keep racing the worker give up and fall back to
+// pg_available_extensions
+#define REGISTRY_READ_RETRIES 1000
+
+typedef struct {
+  // odd while the worker rewrites the entries, readers retry when it changed
+  // under them, like the changecount of the cumulative statistics
+  pg_atomic_uint32 generation;
+  bool             ready;
+  int              total;
+  extension_info   extensions[REGISTRY_MAX_EXTENSIONS]; // sorted by name
+} extension_registry;
+
+static extension_registry *registry          = NULL;
+static bool                worker_registered = false;
+
+static void registry_init(void *ptr) {
+  extension_registry *r = ptr;
+
+  pg_atomic_init_u32(&r->generation, 0);
+  r->ready = false;
+  r->total = 0;
+}
+
+void init_extension_registry(bool enabled) {
+  BackgroundWorker worker = {0};
+
+  if (!enabled || !process_shared_preload_libraries_in_progress) return;
+
+  request_named_shmem(sizeof(extension_registry));
+
+  // the control files are read from disk, no database connection is needed
+  worker.bgw_flags        = BGWORKER_SHMEM_ACCESS;
+  worker.bgw_start_time   = BgWorkerStart_PostmasterStart;
+  worker.bgw_restart_time = 10;
+  strlcpy(worker.bgw_library_name, "supautils", BGW_MAXLEN);
+  strlcpy(worker.bgw_function_name, "supautils_extension_registry_main",
+          BGW_MAXLEN);
+  strlcpy(worker.bgw_name, "supautils extension registry", BGW_MAXLEN);
+  strlcpy(worker.bgw_type, "supautils extension registry", BGW_MAXLEN);
+
+  RegisterBackgroundWorker(&worker);
+
+  worker_registered = true;
+}
+
+static extension_registry *get_registry(void) {
+  if (registry == NULL)
+    registry = get_named_shmem("supautils_extension_registry",
+                               sizeof(extension_registry), registry_init);
+
+  return registry;
+}
+
+// the entries may be torn while the worker writes them, so the total is
+// bounded and the names compared up to NAMEDATALEN
+static int registry_total(const extension_registry *r) {
+  return Min(Max(r->total, 0), REGISTRY_MAX_EXTENSIONS);
+}
+
+registry_lookup lookup_extension(const char *name, extension_info *info) {
+  extension_registry *r;
+
+  if (!worker_registered || (r = get_registry()) == NULL)
+    return REGISTRY_UNAVAILABLE;
+
+  for (int attempt = 0; attempt < REGISTRY_READ_RETRIES; attempt++) {
+    uint32          before = pg_atomic_read_u32(&r->generation);
+    registry_lookup result = REGISTRY_UNAVAILABLE;
+
+    if (before % 2 == 1) {
+      pg_spin_delay();
+      continue;
+    }
+
+    pg_read_barrier();
+
+    if (r->ready) {
+      int low  = 0;
+      int high = registry_total(r) - 1;
+
+      result = REGISTRY_MISSING;
+      while (low <= high) {
+        int mid = low + (high - low) / 2;
+        int cmp = strncmp(name, r->extensions[mid].name, NAMEDATALEN);
+
+        if (cmp == 0) {
+          memcpy(info, &r->extensions[mid], sizeof(extension_info));
+          result = REGISTRY_FOUND;
+          break;
+        }
+
+        if (cmp < 0)
+          high = mid - 1;
+        else
+          low = mid + 1;
+      }
+    }
+
+    pg_read_barrier();
+
+    if (pg_atomic_read_u32(&r->generation) == before) return result;
+  }
+
+  return REGISTRY_UNAVAILABLE;
+}
+
+// Copies all the entries with the same retries as lookup_extension(), returns
+// -1 when the registry is unavailable.
+static int copy_registry(extension_info *out) {
+  extension_registry *r;
+
+  if (!worker_registered || (r = get_registry()) == NULL) return -1;
+
+  for (int attempt = 0; attempt < REGISTRY_READ_RETRIES; attempt++) {
+    uint32 before = pg_atomic_read_u32(&r->generation);
+    int    total  = -1;
+
+    if (before % 2 == 1) {
+      pg_spin_delay();
+      continue;
+    }
+
+    pg_read_barrier();
+
+    if (r->ready) {
+      total = registry_total(r);
+      memcpy(out, r->extensions, total * sizeof(extension_info));
+    }
+
+    pg_read_barrier();
+
+    if (pg_atomic_read_u32(&r->generation) == before) return total;
+  }
+
+  return -1;
+}
+
+// The only writer is the worker, nothing in between can throw so the
+// generation is never left odd.
+static void publish(extension_registry *r, const extension_info *extensions,
+                    int total, bool ready) {
+  // both are full barriers
+  pg_atomic_fetch_add_u32(&r->generation, 1);
+
+  r->ready = ready;
+  r->total = total;
+  memcpy(r->extensions, extensions, total * sizeof(extension_info));
+
+  pg_atomic_fetch_add_u32(&r->generation, 1);
+}
+
+// On pg >= 18 the extensions may also be in the directories of
+// extension_control_path, only pg_available_extensions knows those.
+static bool uses_system_directory(void) {
+#if PG18_GTE
+  const char *path = GetConfigOption("extension_control_path", true, false);
+
+  return path == NULL || strcmp(path, "$system") == 0;
+#else
+  return true;
+#endif
+}
+
+// Gets the extension name of a primary control file, the secondary ones
+// (<name>--<version>.control) are skipped like in pg_available_extensions.
+static bool control_file_extension(const char *filename, char *name) {
+  const char *suffix = strrchr(filename, '.');
+  size_t      len;
+
+  if (suffix == NULL || strcmp(suffix, ".control") != 0) return false;
+
+  len = suffix - filename;
+  if (len == 0 || len >= NAMEDATALEN) return false;
+
+  memcpy(name, filename, len);
+  name[len] = '\0';
+
+  return strstr(name, "--") == NULL;
+}
+
+// Returns false when the control file was removed since it was listed.
+static bool read_control_file(const char *dir, const char *filename,
+                              extension_info *info) {
+  char            path[MAXPGPATH];
+  FILE           *file;
+  ConfigVariable *head = NULL;
+  ConfigVariable *tail = NULL;
+
+  snprintf(path, MAXPGPATH, "%s/%s", dir, filename);
+
+  file = AllocateFile(path, "r");
+  if (file == NULL) {
+    if (errno == ENOENT) return false;
+
+    // still available, CREATE EXTENSION reports the error
+    ereport(LOG, (errcode_for_file_access(),
+                  errmsg("could not open extension control file \"%s\": %m",
+                         path)));
+    return true;
+  }
+
+  (void)ParseConfigFp(file, path, 0, LOG, &head, &tail);
+  FreeFile(file);
+
+  for (ConfigVariable *item = head; item != NULL; item = item->next) {
+    if (strcmp(item->name, "default_version") == 0)
+      strlcpy(info->default_version, item->value, NAMEDATALEN);
+    else if (strcmp(item->name, "requires") == 0)
+      strlcpy(info->requires, item->value, EXTENSION_REQUIRES_LEN);
+  }
+
+  FreeConfigVariables(head);
+
+  return true;
+}
+
+static int compare_extension_info(const void *a, const void *b) {
+  return strcmp(((const extension_info *)a)->name,
+                ((const extension_info *)b)->name);
+}
+
+static void index_extensions(extension_registry *r, const char *dir,
+                             MemoryContext cxt) {
+  MemoryContext   old        = MemoryContextSwitchTo(cxt);
+  extension_info *extensions = palloc0(REGISTRY_MAX_EXTENSIONS *
+                                       sizeof(extension_info));
+  int             total      = 0;
+  bool            ready      = uses_system_directory();
+  DIR            *d          = ready ? AllocateDir(dir) : NULL;
+  struct dirent  *de;
+
+  if (ready && d == NULL) {
+    ereport(LOG,
+            (errcode_for_file_access(),
+             errmsg("could not open extension directory \"%s\": %m", dir)));
+    ready = false;
+  }
+
+  while (d != NULL && (de = ReadDirExtended(d, dir, LOG)) != NULL) {
+    char name[NAMEDATALEN];
+
+    if (!control_file_extension(de->d_name, name)) continue;
+
+    if (total == REGISTRY_MAX_EXTENSIONS) {
+      ereport(LOG, (errmsg("supautils extension registry: more than %d "
+                           "extensions, falling back to "
+                           "pg_available_extensions",
+                           REGISTRY_MAX_EXTENSIONS)));
+      ready = false;
+      break;
+    }
+
+    // the slot of a removed control file is reused
+    memset(&extensions[total], 0, sizeof(extension_info));
+    strlcpy(extensions[total].name, name, NAMEDATALEN);
+    if (read_control_file(dir, de->d_name, &extensions[total])) total++;
+  }
+
+  if (d != NULL) FreeDir(d);
+
+  if (!ready) total = 0;
+
+  qsort(extensions, total, sizeof(extension_info), compare_extension_info);
+
+  publish(r, extensions, total, ready);
+
+  elog(DEBUG1, "supautils extension registry indexed %d extensions", total);
+
+  MemoryContextSwitchTo(old);
+  MemoryContextReset(cxt);
+}
+
+// Returns the inotify descriptor watching the extension directory, or -1 when
+// it's scanned on an interval instead.
+static int watch_directory(const char *dir) {
+#ifdef __linux__
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  int save_errno;
+
+  if (fd >= 0 &&
+      inotify_add_watch(fd, dir,
+                        IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM |
+                            IN_MOVED_TO | IN_ATTRIB) >= 0)
+    return fd;
+
+  save_errno = errno;
+  if (fd >= 0) close(fd);
+  errno = save_errno;
+
+  ereport(LOG, (errmsg("supautils extension registry could not watch \"%s\": "
+                       "%m, scanning it every %d seconds",
+                       dir, REGISTRY_RESCAN_INTERVAL_MS / 1000)));
+#endif
+
+  return -1;
+}
+
+// the events themselves don't matter, the whole directory is scanned again
+static void drain_events(int fd) {
+  char buf[4096];
+
+  while (read(fd, buf, sizeof(buf)) > 0)
+    ;
+}
+
+void supautils_extension_registry_main(__attribute__((unused)) Datum arg) {
+  char          sharepath[MAXPGPATH];
+  char          dir[MAXPGPATH];
+  MemoryContext cxt;
+  int           watch_fd;
+
+  pqsignal(SIGHUP, SignalHandlerForConfigReload);
+  pqsignal(SIGTERM, SignalHandlerForShutdownRequest);
+  BackgroundWorkerUnblockSignals();
+
+  get_registry();
+
+  cxt = AllocSetContextCreate(TopMemoryContext, "supautils extension registry",
+                              ALLOCSET_DEFAULT_SIZES);
+
+  get_share_path(my_exec_path, sharepath);
+  snprintf(dir, MAXPGPATH, "%s/extension", sharepath);
+
+  // watched before the first scan so no change is missed in between
+  watch_fd = watch_directory(dir);
+
+  for (;;) {
+    int events = WL_LATCH_SET | WL_EXIT_ON_PM_DEATH;
+    int rc;
+
+    ResetLatch(MyLatch);
+
+    CHECK_FOR_INTERRUPTS();
+
+    if (ConfigReloadPending) {
+      ConfigReloadPending = false;
+      ProcessConfigFile(PGC_SIGHUP);
+    }
+
+    if (ShutdownRequestPending) proc_exit(0);
+
+    // also on a reload, extension_control_path may have changed
+    index_extensions(registry, dir, cxt);
+
+    events |= watch_fd >= 0 ? WL_SOCKET_READABLE : WL_TIMEOUT;
+    rc = WaitLatchOrSocket(MyLatch, events, watch_fd,
+                           REGISTRY_RESCAN_INTERVAL_MS, PG_WAIT_EXTENSION);
+
+    if (rc & WL_SOCKET_READABLE) {
+      (void)WaitLatch(MyLatch, WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+                      REGISTRY_SETTLE_MS, PG_WAIT_EXTENSION);
+      drain_events(watch_fd);
+    }
+  }
+}
+
+PG_FUNCTION_INFO_V1(supautils_extension_registry);
+Datum supautils_extension_registry(PG_FUNCTION_ARGS) {
+  ReturnSetInfo  *rsinfo     = (ReturnSetInfo *)fcinfo->resultinfo;
+  extension_info *extensions = palloc(REGISTRY_MAX_EXTENSIONS *
+                                      sizeof(extension_info));
+  int             total;
+
+  InitMaterializedSRF(fcinfo, 0);
+
+  // no rows when the registry is unavailable
+  total = copy_registry(extensions);
+
+  for (int i = 0; i < total; i++) {
+    const extension_info *info = &extensions[i];
+    Datum                 values[3];
+    bool                  nulls[3] = {0};
+
+    values[0] = CStringGetTextDatum(info->name);
+
+    if (info->default_version[0] != '\0')
+      values[1] = CStringGetTextDatum(info->default_version);
+    else
+      nulls[1] = true;
+
+    if (info->requires[0] != '\0')
+      values[2] = CStringGetTextDatum(info->requires);
+    else
+      nulls[2] = true;
+
+    tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+  }
+
+  return (Datum)0;
+}
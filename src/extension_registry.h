@@ -0,0 +1,39 @@
+#ifndef EXTENSION_REGISTRY_H
+#define EXTENSION_REGISTRY_H
+
+#include "pg_prelude.h"
+
+// longer lists of required extensions are truncated
+#define EXTENSION_REQUIRES_LEN 256
+
+typedef struct {
+  char name[NAMEDATALEN];
+  char default_version[NAMEDATALEN]; // empty when the control file has none
+  char requires[EXTENSION_REQUIRES_LEN];
+} extension_info;
+
+typedef enum {
+  // not preloaded, not indexed yet or too many extensions to index them all
+  REGISTRY_UNAVAILABLE,
+  REGISTRY_MISSING,
+  REGISTRY_FOUND
+} registry_lookup;
+
+/**
+ * Set up the shared memory registry of the available extensions and register
+ * the background worker that indexes the extension directory into it. Must be
+ * called from _PG_init() before reserve_named_shmem(), the registry stays
+ * unavailable unless supautils is in shared_preload_libraries.
+ */
+extern void init_extension_registry(bool enabled);
+
+/**
+ * Look up an extension by name without taking any lock, copying its entry to
+ * `info` when it's found. Callers fall back to pg_available_extensions unless
+ * it's found, an extension installed since the last scan is still missing.
+ */
+extern registry_lookup lookup_extension(const char *name, extension_info *info);
+
+PGDLLEXPORT void supautils_extension_registry_main(Datum arg);
+
+#endif
@@ -0,0 +1,187 @@
+#include "pg_prelude.h"
+
+#include "constrained_extensions.h"
+#include "extension_slots.h"
+#include "shmem.h"
+#include "stats.h"
+#include "wait_events.h"
+
+// Extensions are counted by name in a fixed array, one entry per constrained
+// extension with statements running, so it can be checked under a spinlock.
+// An entry is free again once nothing runs on its extension.
+#define NO_SLOT -1
+
+typedef struct {
+  NameData name;
+  int      running;
+} extension_slot;
+
+typedef struct {
+  slock_t           mutex;
+  ConditionVariable released;
+  int               total_running;
+  extension_slot    slots[MAX_CONSTRAINED_EXTENSIONS];
+} extension_slots;
+
+static extension_slots *slots = NULL;
+
+// the entry of the slot taken by this backend, nested statements (e.g. from
+// extension custom scripts) run under the slot of the outermost one
+static int held_slot = NO_SLOT;
+
+static void extension_slots_init(void *ptr) {
+  extension_slots *s = ptr;
+
+  SpinLockInit(&s->mutex);
+  ConditionVariableInit(&s->released);
+  s->total_running = 0;
+  memset(s->slots, 0, sizeof(s->slots));
+}
+
+void init_extension_slots(void) {
+  request_named_shmem(sizeof(extension_slots));
+}
+
+static void release_slot_on_exit(__attribute__((unused)) int   code,
+                                 __attribute__((unused)) Datum arg) {
+  release_extension_slot();
+}
+
+static extension_slots *get_slots(void) {
+  if (slots != NULL) return slots;
+
+  slots = get_named_shmem("supautils_extension_slots",
+                          sizeof(extension_slots), extension_slots_init);
+
+  // a FATAL error skips the callers' cleanup
+  if (slots != NULL) before_shmem_exit(release_slot_on_exit, (Datum)0);
+
+  return slots;
+}
+
+// Must be called with the mutex held. Returns the entry of name, or a free
+// one for it. Only the entries in use are compared, there are few of them. All
+// the entries can only be in use by other extensions when the constrained
+// extensions differ across backends (e.g. during a reload), then NO_SLOT is
+// returned and the statement waits like for a busy slot.
+static int find_slot(extension_slots *s, const char *name) {
+  int free_slot = NO_SLOT;
+
+  for (int i = 0; i < MAX_CONSTRAINED_EXTENSIONS; i++) {
+    if (s->slots[i].running == 0) {
+      if (free_slot == NO_SLOT) free_slot = i;
+    } else if (strcmp(NameStr(s->slots[i].name), name) == 0)
+      return i;
+  }
+
+  return free_slot;
+}
+
+// must be called with the mutex held
+static bool has_free_slot(extension_slots *s, int slot, int limit,
+                          int max_running) {
+  return slot != NO_SLOT &&
+         (limit == 0 || s->slots[slot].running < limit) &&
+         (max_running == 0 || s->total_running < max_running);
+}
+
+// returns the entry the slot was taken from, or NO_SLOT
+static int try_take_slot(extension_slots *s, const char *name, int limit,
+                         int max_running) {
+  int slot;
+
+  SpinLockAcquire(&s->mutex);
+  slot = find_slot(s, name);
+  if (has_free_slot(s, slot, limit, max_running)) {
+    if (s->slots[slot].running == 0) namestrcpy(&s->slots[slot].name, name);
+    s->slots[slot].running++;
+    s->total_running++;
+  } else
+    slot = NO_SLOT;
+  SpinLockRelease(&s->mutex);
+
+  return slot;
+}
+
+// the slots to take one from, NULL when the statement runs without a slot
+static extension_slots *needed_slots(int limit, int max_running) {
+  if ((limit == 0 && max_running == 0) || held_slot != NO_SLOT) return NULL;
+
+  // without shared memory the limits can't be enforced across backends
+  return get_slots();
+}
+
+bool acquire_extension_slot(const char *name, int limit, int max_running,
+                            int timeout_ms) {
+  extension_slots *s = needed_slots(limit, max_running);
+  TimestampTz      start;
+  long             waited_ms = 0;
+
+  if (s == NULL) return false;
+
+  held_slot = try_take_slot(s, name, limit, max_running);
+  if (held_slot != NO_SLOT) return true;
+
+  start = GetCurrentTimestamp();
+
+  ConditionVariablePrepareToSleep(&s->released);
+
+  while ((held_slot = try_take_slot(s, name, limit, max_running)) ==
+         NO_SLOT) {
+    long remaining_ms = -1;
+
+    waited_ms = TimestampDifferenceMilliseconds(start, GetCurrentTimestamp());
+
+    if (timeout_ms >= 0) remaining_ms = timeout_ms - waited_ms;
+
+    if (timeout_ms >= 0 && remaining_ms <= 0) {
+      ConditionVariableCancelSleep();
+      stats_incr(STAT_EXT_CONCURRENCY_REJECTED);
+      ereport(ERROR,
+              (errcode(ERRCODE_CONFIGURATION_LIMIT_EXCEEDED),
+               errmsg("too many concurrent statements on constrained "
+                      "extensions, could not run this statement on \"%s\"",
+                      name),
+               errdetail("Waited %ld ms for a slot.", waited_ms),
+               errhint("Try again later.")));
+    }
+
+    (void)ConditionVariableTimedSleep(
+        &s->released, remaining_ms,
+        supautils_wait_event_info(WAIT_EVENT_EXTENSION_SLOT));
+  }
+
+  ConditionVariableCancelSleep();
+
+  waited_ms = TimestampDifferenceMilliseconds(start, GetCurrentTimestamp());
+  stats_incr(STAT_EXT_CONCURRENCY_WAITED);
+  stats_add(STAT_EXT_CONCURRENCY_WAIT_MS, waited_ms);
+
+  return true;
+}
+
+void release_extension_slot(void) {
+  if (held_slot == NO_SLOT) return;
+
+  SpinLockAcquire(&slots->mutex);
+  slots->slots[held_slot].running--;
+  slots->total_running--;
+  SpinLockRelease(&slots->mutex);
+
+  held_slot = NO_SLOT;
+
+  ConditionVariableBroadcast(&slots->released);
+}
+
+const char *peek_extension_slot(const char *name, int limit, int max_running) {
+  extension_slots *s = needed_slots(limit, max_running);
+  bool             available;
+
+  if (s == NULL) return "none";
+
+  SpinLockAcquire(&s->mutex);
+  available = has_free_slot(s, find_slot(s, name), limit, max_running);
+  SpinLockRelease(&s->mutex);
+
+  return available ? "free" : "busy";
+}
@@ -0,0 +1,33 @@
+#ifndef EXTENSION_SLOTS_H
+#define EXTENSION_SLOTS_H
+
+#include "pg_prelude.h"
+
+/**
+ * Set up the shared memory for the slots. Must be called from _PG_init().
+ */
+extern void init_extension_slots(void);
+
+/**
+ * Take a slot to run DDL on the extension `name`, when fewer than `limit`
+ * statements run on it and fewer than `max_running` on all the constrained
+ * extensions. A limit of 0 means no limit.
+ *
+ * Waits up to `timeout_ms` for a slot to free up (forever when -1), then
+ * errors out. Returns true when a slot was taken, the caller must give it back
+ * with release_extension_slot(), also on error.
+ */
+extern bool acquire_extension_slot(const char *name, int limit,
+                                   int max_running, int timeout_ms);
+
+extern void release_extension_slot(void);
+
+/**
+ * What acquire_extension_slot() would do right now, without taking a slot:
+ * "none" when it doesn't need one, "free" when it takes one right away and
+ * "busy" when it has to wait.
+ */
+extern const char *peek_extension_slot(const char *name, int limit,
+                                       int max_running);
+
+#endif
@@ -1,6 +1,8 @@
-#include "extensions_parameter_overrides.h"
 #include "pg_prelude.h"
-#include "utils.h"
+
+#include "extensions_parameter_overrides.h"
+#include "memory.h"
+#include "stats.h"
 
 static JSON_ACTION_RETURN_TYPE json_array_start(void *state) {
   json_extension_parameter_overrides_parse_state *parse = state;
@@ -47,7 +49,14 @@ json_object_field_start(void *state, char *fname,
 
   switch (parse->state) {
   case JEPO_EXPECT_TOPLEVEL_FIELD:
-    x->name      = MemoryContextStrdup(TopMemoryContext, fname);
+    if (parse->total_epos >= MAX_EXTENSIONS_PARAMETER_OVERRIDES) {
+      parse->state     = JEPO_TOO_MANY_EXTENSIONS;
+      parse->error_msg = "too many extensions, the maximum is "
+                         CppAsString2(MAX_EXTENSIONS_PARAMETER_OVERRIDES);
+      break;
+    }
+    x->name      = MemoryContextStrdup(
+        get_memory_context(MEMCXT_EXTENSIONS_PARAMETER_OVERRIDES), fname);
     parse->state = JEPO_EXPECT_PARAMETER_OVERRIDES_START;
     break;
 
@@ -62,6 +71,7 @@ json_object_field_start(void *state, char *fname,
 
   default: break;
   }
+  pfree(fname);
   JSON_ACTION_RETURN;
 }
 
@@ -73,7 +83,8 @@ static JSON_ACTION_RETURN_TYPE json_scalar(void *state, char *token,
   switch (parse->state) {
   case JEPO_EXPECT_SCHEMA:
     if (tokentype == JSON_TOKEN_STRING) {
-      x->schema    = MemoryContextStrdup(TopMemoryContext, token);
+      x->schema    = MemoryContextStrdup(
+          get_memory_context(MEMCXT_EXTENSIONS_PARAMETER_OVERRIDES), token);
       parse->state = JEPO_EXPECT_PARAMETER_OVERRIDES_START;
     } else {
       parse->state     = JEPO_UNEXPECTED_SCHEMA_VALUE;
@@ -93,6 +104,7 @@ static JSON_ACTION_RETURN_TYPE json_scalar(void *state, char *token,
 
   default: break;
   }
+  pfree(token);
   JSON_ACTION_RETURN;
 }
 
@@ -102,12 +114,12 @@ parse_extensions_parameter_overrides(const char                    *str,
   JsonLexContext    *lex;
   JsonParseErrorType json_error;
   JsonSemAction      sem;
+  char              *json = pstrdup(str);
 
   json_extension_parameter_overrides_parse_state state = {
     JEPO_EXPECT_TOPLEVEL_START, NULL, 0, epos};
 
-  lex = NEW_JSON_LEX_CONTEXT_CSTRING_LEN(pstrdup(str), strlen(str), PG_UTF8,
-                                         true);
+  lex = NEW_JSON_LEX_CONTEXT_CSTRING_LEN(json, strlen(json), PG_UTF8, true);
 
   sem.semstate            = &state;
   sem.object_start        = json_object_start;
@@ -124,9 +136,14 @@ parse_extensions_parameter_overrides(const char                    *str,
 
   if (json_error != JSON_SUCCESS) state.error_msg = "invalid json";
 
+  FREE_JSON_LEX_CONTEXT(lex);
+  pfree(json);
+
   return state;
 }
 
+#ifndef FRONTEND
+
 List *override_ext_options(extension_stmt_kind stmt_kind, const char *extname,
                            List *options, const size_t total_epos,
                            const extension_parameter_overrides *epos) {
@@ -164,9 +181,13 @@ List *override_ext_options(extension_stmt_kind stmt_kind, const char *extname,
           options = list_delete_ptr(options, schema_option);
         }
         options = lappend(options, schema_override_option);
+
+        stats_incr(STAT_EXT_SCHEMA_OVERRIDDEN);
       }
     }
   }
 
   return options;
 }
+
+#endif
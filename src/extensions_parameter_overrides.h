@@ -3,6 +3,8 @@
 
 #include "pg_prelude.h"
 
+#define MAX_EXTENSIONS_PARAMETER_OVERRIDES 100
+
 typedef struct {
   char *name;
   char *schema;
@@ -17,7 +19,8 @@ typedef enum {
   JEPO_UNEXPECTED_ARRAY,
   JEPO_UNEXPECTED_SCALAR,
   JEPO_UNEXPECTED_OBJECT,
-  JEPO_UNEXPECTED_SCHEMA_VALUE
+  JEPO_UNEXPECTED_SCHEMA_VALUE,
+  JEPO_TOO_MANY_EXTENSIONS
 } json_extension_parameter_overrides_semantic_state;
 
 typedef struct {
@@ -33,9 +36,13 @@ extern json_extension_parameter_overrides_parse_state
 parse_extensions_parameter_overrides(const char                    *str,
                                      extension_parameter_overrides *epos);
 
+#ifndef FRONTEND
+
 extern List *override_ext_options(extension_stmt_kind stmt_kind,
                                   const char *extname, List *options,
                                   const size_t total_epos,
                                   const extension_parameter_overrides *epos);
 
 #endif
+
+#endif
@@ -0,0 +1,212 @@
+#include "pg_prelude.h"
+
+#include "hook_latency.h"
+#include "shmem.h"
+#include "utils.h"
+
+// bucket 0 counts samples under 1ns, bucket i samples in [2^(i-1), 2^i) ns and
+// the last bucket everything above, ~17s
+#define LATENCY_BUCKETS 36
+
+// samples are buffered per backend and added to the shared histograms in
+// batches to avoid contention on the atomics
+#define FLUSH_THRESHOLD 64
+
+// the utility statements supautils handles, everything else is "other"
+static const struct {
+  NodeTag     tag;
+  const char *name;
+} utility_tags[] = {
+  {T_AlterRoleStmt, "AlterRoleStmt"},
+  {T_AlterRoleSetStmt, "AlterRoleSetStmt"},
+  {T_CreateRoleStmt, "CreateRoleStmt"},
+  {T_DropRoleStmt, "DropRoleStmt"},
+  {T_GrantRoleStmt, "GrantRoleStmt"},
+  {T_RenameStmt, "RenameStmt"},
+  {T_CreateExtensionStmt, "CreateExtensionStmt"},
+  {T_AlterExtensionStmt, "AlterExtensionStmt"},
+  {T_AlterObjectSchemaStmt, "AlterObjectSchemaStmt"},
+  {T_AlterExtensionContentsStmt, "AlterExtensionContentsStmt"},
+  {T_CreateFdwStmt, "CreateFdwStmt"},
+  {T_CreatePublicationStmt, "CreatePublicationStmt"},
+  {T_AlterPublicationStmt, "AlterPublicationStmt"},
+  {T_CreatePolicyStmt, "CreatePolicyStmt"},
+  {T_AlterPolicyStmt, "AlterPolicyStmt"},
+  {T_DropStmt, "DropStmt"},
+  {T_CommentStmt, "CommentStmt"},
+  {T_VariableSetStmt, "VariableSetStmt"},
+  {T_CreateEventTrigStmt, "CreateEventTrigStmt"},
+  {T_AlterTableStmt, "AlterTableStmt"},
+  {T_IndexStmt, "IndexStmt"},
+  {T_ReindexStmt, "ReindexStmt"},
+};
+
+#define TOTAL_UTILITY_TAGS lengthof(utility_tags)
+#define TOTAL_SERIES (HOOK_PROCESS_UTILITY + TOTAL_UTILITY_TAGS + 1)
+
+typedef struct {
+  pg_atomic_uint64 buckets[TOTAL_SERIES][LATENCY_BUCKETS];
+} hook_latency_shared;
+
+static hook_latency_shared *latency = NULL;
+
+// Used when there's no shared memory available (supautils is not preloaded on
+// pg < 17), the histograms are per backend in that case.
+static hook_latency_shared local_latency;
+
+static uint64 pending[TOTAL_SERIES][LATENCY_BUCKETS] = {0};
+static int    total_pending                          = 0;
+
+static void hook_latency_shared_init(void *ptr) {
+  hook_latency_shared *l = ptr;
+
+  for (size_t i = 0; i < TOTAL_SERIES; i++)
+    for (int j = 0; j < LATENCY_BUCKETS; j++)
+      pg_atomic_init_u64(&l->buckets[i][j], 0);
+}
+
+void init_hook_latency(void) {
+  request_named_shmem(sizeof(hook_latency_shared));
+}
+
+static void flush_pending(void) {
+  if (total_pending == 0) return;
+
+  for (size_t i = 0; i < TOTAL_SERIES; i++)
+    for (int j = 0; j < LATENCY_BUCKETS; j++) {
+      if (pending[i][j] == 0) continue;
+
+      pg_atomic_fetch_add_u64(&latency->buckets[i][j], pending[i][j]);
+      pending[i][j] = 0;
+    }
+
+  total_pending = 0;
+}
+
+static void flush_pending_on_exit(__attribute__((unused)) int code,
+                                  __attribute__((unused)) Datum arg) {
+  flush_pending();
+}
+
+static hook_latency_shared *get_latency(void) {
+  if (latency != NULL) return latency;
+
+  latency = get_named_shmem("supautils_hook_latency",
+                            sizeof(hook_latency_shared),
+                            hook_latency_shared_init);
+
+  if (latency == NULL) {
+    hook_latency_shared_init(&local_latency);
+    latency = &local_latency;
+  }
+
+  // runs before the shared memory is detached
+  before_shmem_exit(flush_pending_on_exit, (Datum)0);
+
+  return latency;
+}
+
+hook_series utility_hook_series(NodeTag tag) {
+  for (size_t i = 0; i < TOTAL_UTILITY_TAGS; i++)
+    if (utility_tags[i].tag == tag) return HOOK_PROCESS_UTILITY + i;
+
+  return HOOK_PROCESS_UTILITY + TOTAL_UTILITY_TAGS;
+}
+
+void hook_timer_stop(hook_timer *timer, hook_series series) {
+  instr_time elapsed;
+  uint64     ns;
+  int        bucket;
+
+  if (!timer->enabled) return;
+
+  INSTR_TIME_SET_CURRENT(elapsed);
+  INSTR_TIME_SUBTRACT(elapsed, timer->start);
+  INSTR_TIME_SUBTRACT(elapsed, timer->chained);
+
+  ns     = INSTR_TIME_GET_NS(elapsed);
+  bucket = ns == 0 ? 0 : pg_leftmost_one_pos64(ns) + 1;
+  bucket = Min(bucket, LATENCY_BUCKETS - 1);
+
+  get_latency();
+
+  pending[series][bucket]++;
+  if (++total_pending >= FLUSH_THRESHOLD) flush_pending();
+}
+
+static void series_name(size_t series, const char **hook,
+                        const char **node_type) {
+  *node_type = NULL;
+
+  switch (series) {
+  case HOOK_EXECUTOR_START: *hook = "executor_start"; break;
+  case HOOK_EXECUTOR_START_HINT: *hook = "executor_start_hint"; break;
+  case HOOK_NEEDS_FMGR: *hook = "needs_fmgr"; break;
+  case HOOK_FMGR: *hook = "fmgr"; break;
+  default:
+    *hook = "process_utility";
+    *node_type = series - HOOK_PROCESS_UTILITY < TOTAL_UTILITY_TAGS
+                   ? utility_tags[series - HOOK_PROCESS_UTILITY].name
+                   : "other";
+    break;
+  }
+}
+
+PG_FUNCTION_INFO_V1(supautils_hook_latency);
+Datum supautils_hook_latency(PG_FUNCTION_ARGS) {
+  ReturnSetInfo       *rsinfo = (ReturnSetInfo *)fcinfo->resultinfo;
+  hook_latency_shared *l;
+
+  InitMaterializedSRF(fcinfo, 0);
+
+  l = get_latency();
+
+  // so the current backend sees its own samples
+  flush_pending();
+
+  for (size_t i = 0; i < TOTAL_SERIES; i++) {
+    const char *hook;
+    const char *node_type;
+
+    series_name(i, &hook, &node_type);
+
+    for (int j = 0; j < LATENCY_BUCKETS; j++) {
+      Datum  values[4];
+      bool   nulls[4] = {0};
+      uint64 count    = pg_atomic_read_u64(&l->buckets[i][j]);
+
+      if (count == 0) continue;
+
+      values[0] = CStringGetTextDatum(hook);
+      if (node_type != NULL)
+        values[1] = CStringGetTextDatum(node_type);
+      else
+        nulls[1] = true;
+      // the last bucket has no upper bound
+      if (j < LATENCY_BUCKETS - 1)
+        values[2] = Int64GetDatum((int64)1 << j);
+      else
+        nulls[2] = true;
+      values[3] = Int64GetDatum((int64)count);
+
+      tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+    }
+  }
+
+  return (Datum)0;
+}
+
+PG_FUNCTION_INFO_V1(supautils_hook_latency_reset);
+Datum supautils_hook_latency_reset(__attribute__((unused)) PG_FUNCTION_ARGS) {
+  hook_latency_shared *l = get_latency();
+
+  for (size_t i = 0; i < TOTAL_SERIES; i++)
+    for (int j = 0; j < LATENCY_BUCKETS; j++) {
+      pg_atomic_write_u64(&l->buckets[i][j], 0);
+      pending[i][j] = 0;
+    }
+
+  total_pending = 0;
+
+  PG_RETURN_VOID();
+}
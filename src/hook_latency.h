@@ -0,0 +1,62 @@
+#ifndef HOOK_LATENCY_H
+#define HOOK_LATENCY_H
+
+#include "pg_prelude.h"
+
+#if PG16_GTE
+#  define INSTR_TIME_GET_NS(t) ((uint64)INSTR_TIME_GET_NANOSEC(t))
+#else
+#  define INSTR_TIME_GET_NS(t) ((uint64)(INSTR_TIME_GET_DOUBLE(t) * 1e9))
+#endif
+
+typedef enum {
+  HOOK_EXECUTOR_START,
+  HOOK_EXECUTOR_START_HINT,
+  HOOK_NEEDS_FMGR,
+  HOOK_FMGR,
+  // one series per utility node type, see utility_hook_series()
+  HOOK_PROCESS_UTILITY,
+} hook_series;
+
+typedef struct {
+  bool       enabled;
+  instr_time start;
+  instr_time paused_at;
+  instr_time chained;
+} hook_timer;
+
+/**
+ * Set up the shared memory for the histograms. Must be called from _PG_init().
+ */
+extern void init_hook_latency(void);
+
+extern hook_series utility_hook_series(NodeTag tag);
+
+static inline void hook_timer_start(hook_timer *timer, bool enabled) {
+  timer->enabled = enabled;
+  if (!enabled) return;
+
+  INSTR_TIME_SET_ZERO(timer->chained);
+  INSTR_TIME_SET_CURRENT(timer->start);
+}
+
+// the time between pause and resume is spent on chained hooks and is not
+// counted as supautils time
+static inline void hook_timer_pause(hook_timer *timer) {
+  if (!timer->enabled) return;
+
+  INSTR_TIME_SET_CURRENT(timer->paused_at);
+}
+
+static inline void hook_timer_resume(hook_timer *timer) {
+  instr_time now;
+
+  if (!timer->enabled) return;
+
+  INSTR_TIME_SET_CURRENT(now);
+  INSTR_TIME_ACCUM_DIFF(timer->chained, now, timer->paused_at);
+}
+
+extern void hook_timer_stop(hook_timer *timer, hook_series series);
+
+#endif
@@ -0,0 +1,55 @@
+#include "pg_prelude.h"
+
+#include "memory.h"
+#include "utils.h"
+
+// names for every supautils_memory_context, in the same order
+static const char *const memory_context_names[MEMCXT_COUNT] = {
+  "constrained_extensions",
+  "extensions_parameter_overrides",
+  "policy_grants",
+  "drop_trigger_grants",
+  "placeholders",
+  "reserved_memberships",
+  "config_ceilings",
+  "permission_hints",
+};
+
+static MemoryContext supautils_context             = NULL;
+static MemoryContext memory_contexts[MEMCXT_COUNT] = {0};
+
+// contexts are created on first use so unused features don't take memory
+MemoryContext get_memory_context(supautils_memory_context which) {
+  if (memory_contexts[which] != NULL) return memory_contexts[which];
+
+  if (supautils_context == NULL)
+    supautils_context = AllocSetContextCreate(TopMemoryContext, "supautils",
+                                              ALLOCSET_SMALL_SIZES);
+
+  memory_contexts[which] = AllocSetContextCreate(
+      supautils_context, memory_context_names[which], ALLOCSET_SMALL_SIZES);
+
+  return memory_contexts[which];
+}
+
+PG_FUNCTION_INFO_V1(supautils_memory_usage);
+Datum supautils_memory_usage(PG_FUNCTION_ARGS) {
+  ReturnSetInfo *rsinfo = (ReturnSetInfo *)fcinfo->resultinfo;
+
+  InitMaterializedSRF(fcinfo, 0);
+
+  for (int i = 0; i < MEMCXT_COUNT; i++) {
+    Datum values[2];
+    bool  nulls[2] = {0};
+
+    values[0] = CStringGetTextDatum(memory_context_names[i]);
+    values[1] = Int64GetDatum(
+        memory_contexts[i] != NULL
+            ? (int64)MemoryContextMemAllocated(memory_contexts[i], true)
+            : 0);
+
+    tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+  }
+
+  return (Datum)0;
+}
@@ -0,0 +1,35 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include "pg_prelude.h"
+
+typedef enum {
+  MEMCXT_CONSTRAINED_EXTENSIONS,
+  MEMCXT_EXTENSIONS_PARAMETER_OVERRIDES,
+  MEMCXT_POLICY_GRANTS,
+  MEMCXT_DROP_TRIGGER_GRANTS,
+  MEMCXT_PLACEHOLDERS,
+  MEMCXT_RESERVED_MEMBERSHIPS,
+  MEMCXT_CONFIG_CEILINGS,
+  MEMCXT_PERMISSION_HINTS,
+  MEMCXT_COUNT
+} supautils_memory_context;
+
+#ifdef FRONTEND
+
+// the frontend has no memory contexts, the parsed configs live until exit
+#  define get_memory_context(which) NULL
+#  define MemoryContextStrdup(cxt, str) pstrdup(str)
+
+#else
+
+/**
+ * Get the long-lived memory context of a subsystem. Every context is a child
+ * of a "supautils" context under TopMemoryContext, so they show up together in
+ * pg_backend_memory_contexts.
+ */
+extern MemoryContext get_memory_context(supautils_memory_context which);
+
+#endif
+
+#endif
@@ -1,9 +1,131 @@
 #include "pg_prelude.h"
 
+#include "memory.h"
 #include "permission_hints.h"
 
+// at most this many relations are remembered per cached plan, plans with more
+// are not cached
+#define HINT_CACHE_MAX_RELATIONS 8
+
+// the cache is emptied when it's full
+#define HINT_CACHE_MAX_ENTRIES 256
+
+typedef struct {
+  Oid     relid;
+  AclMode acl;
+} missing_perm;
+
+// the permission check of a relation, as in RTEPermissionInfo
+typedef struct {
+  Oid        relid;
+  Oid        check_as_user;
+  AclMode    required_perms;
+  Bitmapset *selected_cols;
+  Bitmapset *inserted_cols;
+  Bitmapset *updated_cols;
+} perm_check;
+
+typedef struct {
+  // hash of the permission checks of the plan
+  uint32 signature;
+  Oid    role;
+} hint_cache_key;
+
+typedef struct {
+  hint_cache_key key; // hash key
+  int            total_checks;
+  perm_check     checks[HINT_CACHE_MAX_RELATIONS];
+  Oid            missing_relid;
+  char          *hint; // NULL when no hint applies
+} hint_cache_entry;
+
+// The hints of the plans that failed with a permission error, so a client
+// retrying the same statement gets its hint without another walk over the
+// ACLs. An entry is dropped when one of its relations changes, the whole cache
+// when a role or a membership changes.
+static HTAB *hint_cache       = NULL;
+static bool  hint_cache_stale = false;
+
+// bumped on every invalidation, a hint computed across one is not cached
+static uint64 hint_cache_generation = 0;
+
+// frees what the entry holds in the cache context, not the entry itself
+static void free_hint_cache_entry(hint_cache_entry *entry) {
+  for (int i = 0; i < entry->total_checks; i++) {
+    bms_free(entry->checks[i].selected_cols);
+    bms_free(entry->checks[i].inserted_cols);
+    bms_free(entry->checks[i].updated_cols);
+  }
+
+  if (entry->hint != NULL) pfree(entry->hint);
+}
+
+static void
+hint_cache_relcache_callback(__attribute__((unused)) Datum arg, Oid relid) {
+  HASH_SEQ_STATUS   status;
+  hint_cache_entry *entry;
+
+  hint_cache_generation++;
+
+  if (hint_cache == NULL) return;
+
+  if (!OidIsValid(relid)) {
+    hint_cache_stale = true;
+    return;
+  }
+
+  hash_seq_init(&status, hint_cache);
+  while ((entry = hash_seq_search(&status)) != NULL) {
+    for (int i = 0; i < entry->total_checks; i++) {
+      if (entry->checks[i].relid != relid) continue;
+
+      free_hint_cache_entry(entry);
+      hash_search(hint_cache, &entry->key, HASH_REMOVE, NULL);
+      break;
+    }
+  }
+}
+
+static void
+hint_cache_syscache_callback(__attribute__((unused)) Datum  arg,
+                             __attribute__((unused)) int    cacheid,
+                             __attribute__((unused)) uint32 hashvalue) {
+  hint_cache_generation++;
+  hint_cache_stale = true;
+}
+
+void init_permission_hints(void) {
+  // GRANT and REVOKE on a table or its columns invalidate its relcache entry
+  CacheRegisterRelcacheCallback(hint_cache_relcache_callback, (Datum)0);
+  CacheRegisterSyscacheCallback(AUTHMEMROLEMEM, hint_cache_syscache_callback,
+                                (Datum)0);
+  // the hints have the role name
+  CacheRegisterSyscacheCallback(AUTHOID, hint_cache_syscache_callback,
+                                (Datum)0);
+}
+
+static HTAB *get_hint_cache(void) {
+  MemoryContext cxt = get_memory_context(MEMCXT_PERMISSION_HINTS);
+  HASHCTL       ctl = {0};
+
+  if (hint_cache != NULL && !hint_cache_stale &&
+      hash_get_num_entries(hint_cache) < HINT_CACHE_MAX_ENTRIES)
+    return hint_cache;
+
+  MemoryContextReset(cxt);
+  hint_cache_stale = false;
+
+  ctl.keysize   = sizeof(hint_cache_key);
+  ctl.entrysize = sizeof(hint_cache_entry);
+  ctl.hcxt      = cxt;
+  hint_cache    = hash_create("supautils permission hints", 64, &ctl,
+                              HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+  return hint_cache;
+}
+
 // builds a comma-separated list of missing privileges
-void build_privileges_string(StringInfo buf, AclMode missing_acl) {
+static void build_privileges_string(StringInfo buf, AclMode missing_acl) {
   static const struct {
     AclMode     acl;
     const char *name;
@@ -20,11 +142,81 @@ void build_privileges_string(StringInfo buf, AclMode missing_acl) {
   }
 }
 
+// The privileges a role holds on the columns of a relation, read in one pass
+// over its attributes instead of a syscache lookup per column and privilege
+typedef struct {
+  AclMode  any;  // held on at least one column
+  AclMode  all;  // held on every column
+  AclMode *cols; // indexed by the column bitmapset members
+  int      total_cols;
+} column_privileges;
+
+// the largest member of the column bitmapsets, -1 when they're all empty
+static int max_column(const Bitmapset *a, const Bitmapset *b,
+                      const Bitmapset *c) {
+  return Max(Max(bms_prev_member(a, -1), bms_prev_member(b, -1)),
+             Max(bms_prev_member(c, -1), -1));
+}
+
+static column_privileges get_column_privileges(Oid relid, Oid userid,
+                                               AclMode modes, int max_col) {
+  column_privileges privs    = {.any = 0, .all = modes};
+  bool              has_cols = false;
+  HeapTuple         reltup;
+  Oid               owner;
+  CatCList         *attrs;
+
+  privs.total_cols = max_col + 1;
+  privs.cols       = palloc0(Max(privs.total_cols, 1) * sizeof(AclMode));
+
+  reltup = SearchSysCache1(RELOID, ObjectIdGetDatum(relid));
+  if (!HeapTupleIsValid(reltup)) {
+    privs.all = 0;
+    return privs;
+  }
+  owner = ((Form_pg_class)GETSTRUCT(reltup))->relowner;
+  ReleaseSysCache(reltup);
+
+  attrs = SearchSysCacheList1(ATTNUM, ObjectIdGetDatum(relid));
+
+  for (int i = 0; i < attrs->n_members; i++) {
+    HeapTuple         tup  = &attrs->members[i]->tuple;
+    Form_pg_attribute att  = (Form_pg_attribute)GETSTRUCT(tup);
+    int               col  = att->attnum - FirstLowInvalidHeapAttributeNumber;
+    AclMode           mask = 0;
+    Datum             acl;
+    bool              isnull;
+
+    if (att->attisdropped) continue;
+
+    // a column without an ACL has no column privileges
+    acl = SysCacheGetAttr(ATTNUM, tup, Anum_pg_attribute_attacl, &isnull);
+    if (!isnull)
+      mask = aclmask(DatumGetAclP(acl), userid, owner, modes, ACLMASK_ALL);
+
+    if (col < privs.total_cols) privs.cols[col] = mask;
+
+    // system columns don't count for the whole relation, like in
+    // pg_attribute_aclcheck_all()
+    if (att->attnum > 0) {
+      privs.any |= mask;
+      privs.all &= mask;
+      has_cols   = true;
+    }
+  }
+
+  ReleaseSysCacheList(attrs);
+
+  if (!has_cols) privs.all = 0;
+
+  return privs;
+}
+
 // This logic is mostly copied from ExecCheckPermissionsModified in core, see
 // https://github.com/postgres/postgres/blob/851f6649cc18c4b482fa2b6afddb65b35d035370/src/backend/executor/execMain.c#L755
 // With the difference that we also include SELECT column privileges handling
 // for consolidation
-static bool has_column_perms(Oid relid, Oid userid, Bitmapset *cols,
+static bool has_column_perms(const column_privileges *privs, Bitmapset *cols,
                              AclMode required_perms) {
   int col = -1;
 
@@ -32,8 +224,7 @@ static bool has_column_perms(Oid relid, Oid userid, Bitmapset *cols,
   // there's any column-level priv On INSERT this also happens on INSERT DEFAULT
   // VALUES and on UPDATE it also happens on SELECT FOR UPDATE
   if (!cols || bms_is_empty(cols)) {
-    return pg_attribute_aclcheck_all(relid, userid, required_perms,
-                                     ACLMASK_ANY) == ACLCHECK_OK;
+    return (privs->any & required_perms) != 0;
   }
 
   // otherwise check for all column privileges
@@ -44,13 +235,9 @@ static bool has_column_perms(Oid relid, Oid userid, Bitmapset *cols,
     // have to check for all column privs
     // `*` cannot happen for INSERT and UDPATE so we don't handle them
     if (attno == InvalidAttrNumber && required_perms == ACL_SELECT) {
-      if (pg_attribute_aclcheck_all(relid, userid, required_perms,
-                                    ACLMASK_ALL) != ACLCHECK_OK)
-        return false;
+      if ((privs->all & required_perms) == 0) return false;
     } else { // check all columns
-      if (pg_attribute_aclcheck(relid, attno, userid, required_perms) !=
-          ACLCHECK_OK)
-        return false;
+      if ((privs->cols[col] & required_perms) == 0) return false;
     }
   }
 
@@ -89,29 +276,40 @@ static AclMode get_missing_aclmode(
   // intersect required with missing table-level perms
   AclMode missing_perms = info->requiredPerms & ~rel_perm;
 
+  // the column privileges are only read when a table-wide one is missing
+  AclMode column_modes = missing_perms & (ACL_SELECT | ACL_INSERT | ACL_UPDATE);
+
+  if (column_modes == 0) return missing_perms;
+
+  column_privileges privs = get_column_privileges(
+      info->relid, userid, column_modes,
+      max_column(info->selectedCols, info->insertedCols, info->updatedCols));
+
   // Is the table-wide SELECT privilege missing? If so, check for complete
   // column-level privileges
   if ((missing_perms & ACL_SELECT) &&
-      has_column_perms(info->relid, userid, info->selectedCols, ACL_SELECT))
+      has_column_perms(&privs, info->selectedCols, ACL_SELECT))
     missing_perms &=
         ~ACL_SELECT; // if all good then remove ACL_SELECT from missing_perms
 
   // Same for INSERT and UPDATE
   if ((missing_perms & ACL_INSERT) &&
-      has_column_perms(info->relid, userid, info->insertedCols, ACL_INSERT))
+      has_column_perms(&privs, info->insertedCols, ACL_INSERT))
     missing_perms &= ~ACL_INSERT;
 
   if ((missing_perms & ACL_UPDATE) &&
-      has_column_perms(info->relid, userid, info->updatedCols, ACL_UPDATE))
+      has_column_perms(&privs, info->updatedCols, ACL_UPDATE))
     missing_perms &= ~ACL_UPDATE;
 
+  pfree(privs.cols);
+
   return missing_perms;
 }
 
 // Given the required RTEPermissionInfo list from the query and the role oid,
 // we find the first missing ACL (which should also match the failed acl on
 // ERRCODE_INSUFFICIENT_PRIVILEGE)
-missing_perm find_missing_perm(PlannedStmt *ps, Oid current_role_oid) {
+static missing_perm find_missing_perm(PlannedStmt *ps, Oid current_role_oid) {
   missing_perm result = {.relid = InvalidOid, .acl = 0};
 
 #if PG16_LT
@@ -132,3 +330,138 @@ missing_perm find_missing_perm(PlannedStmt *ps, Oid current_role_oid) {
 
   return result;
 }
+
+static char *build_permission_hint(PlannedStmt *ps, Oid current_role_oid,
+                                   Oid *relid) {
+  missing_perm   missing = find_missing_perm(ps, current_role_oid);
+  StringInfoData privileges;
+  char          *relname;
+
+  *relid = missing.relid;
+
+  if (missing.acl == 0 || !OidIsValid(missing.relid) ||
+      (missing.acl & (ACL_TRUNCATE | ACL_TRIGGER | ACL_REFERENCES)) != 0)
+    return NULL;
+
+  initStringInfo(&privileges);
+  build_privileges_string(&privileges, missing.acl);
+
+  relname = get_rel_name(missing.relid);
+
+  if (privileges.len == 0 || relname == NULL) return NULL;
+
+  return psprintf(
+      "Grant the required privileges to the current role with: GRANT %s ON "
+      "%s TO %s;",
+      privileges.data,
+      quote_qualified_identifier(
+          get_namespace_name(get_rel_namespace(missing.relid)), relname),
+      quote_qualified_identifier(NULL,
+                                 GetUserNameFromId(current_role_oid, false)));
+}
+
+// Hashes the permission checks of the plan, two plans with the same checks get
+// the same hint. Returns the number of relations checked or -1 when there are
+// too many to cache the plan. The checks point to the bitmapsets of the plan.
+static int plan_signature(PlannedStmt *ps, uint32 *signature,
+                          perm_check *checks) {
+  int total = 0;
+
+  *signature = 0;
+
+#if PG16_LT
+  foreach_ptr(RangeTblEntry, info, ps->rtable) {
+    if (!OidIsValid(info->relid)) continue;
+#else
+  foreach_ptr(RTEPermissionInfo, info, ps->permInfos) {
+#endif
+    if (total == HINT_CACHE_MAX_RELATIONS) return -1;
+
+    checks[total++] = (perm_check){
+        .relid          = info->relid,
+        .check_as_user  = info->checkAsUser,
+        .required_perms = info->requiredPerms,
+        .selected_cols  = info->selectedCols,
+        .inserted_cols  = info->insertedCols,
+        .updated_cols   = info->updatedCols,
+    };
+
+    *signature = hash_combine(*signature, hash_bytes_uint32(info->relid));
+    *signature =
+        hash_combine(*signature, hash_bytes_uint32(info->checkAsUser));
+    *signature = hash_combine(*signature,
+                              hash_bytes_uint32((uint32)info->requiredPerms));
+    *signature = hash_combine(*signature, bms_hash_value(info->selectedCols));
+    *signature = hash_combine(*signature, bms_hash_value(info->insertedCols));
+    *signature = hash_combine(*signature, bms_hash_value(info->updatedCols));
+  }
+
+  return total;
+}
+
+// The signature can collide, so a cached hint is only used when the entry has
+// the same permission checks as the plan
+static bool same_perm_checks(const hint_cache_entry *entry,
+                             const perm_check *checks, int total_checks) {
+  if (entry->total_checks != total_checks) return false;
+
+  for (int i = 0; i < total_checks; i++) {
+    const perm_check *a = &entry->checks[i];
+    const perm_check *b = &checks[i];
+
+    if (a->relid != b->relid || a->check_as_user != b->check_as_user ||
+        a->required_perms != b->required_perms ||
+        !bms_equal(a->selected_cols, b->selected_cols) ||
+        !bms_equal(a->inserted_cols, b->inserted_cols) ||
+        !bms_equal(a->updated_cols, b->updated_cols))
+      return false;
+  }
+
+  return true;
+}
+
+char *find_permission_hint(PlannedStmt *ps, Oid current_role_oid, Oid *relid) {
+  hint_cache_key    key          = {.role = current_role_oid};
+  uint64            generation   = hint_cache_generation;
+  perm_check        checks[HINT_CACHE_MAX_RELATIONS];
+  int               total_checks = plan_signature(ps, &key.signature, checks);
+  MemoryContext     oldcxt;
+  hint_cache_entry *entry;
+  bool              found;
+  char             *hint;
+
+  if (total_checks < 0)
+    return build_permission_hint(ps, current_role_oid, relid);
+
+  entry = hash_search(get_hint_cache(), &key, HASH_FIND, NULL);
+
+  if (entry != NULL && same_perm_checks(entry, checks, total_checks)) {
+    *relid = entry->missing_relid;
+    return entry->hint != NULL ? pstrdup(entry->hint) : NULL;
+  }
+
+  hint = build_permission_hint(ps, current_role_oid, relid);
+
+  // the ACLs may have changed while the hint was built
+  if (generation != hint_cache_generation) return hint;
+
+  entry = hash_search(get_hint_cache(), &key, HASH_ENTER, &found);
+  if (found) free_hint_cache_entry(entry);
+
+  oldcxt = MemoryContextSwitchTo(get_memory_context(MEMCXT_PERMISSION_HINTS));
+
+  entry->total_checks  = total_checks;
+  entry->missing_relid = *relid;
+  entry->hint          = hint != NULL ? pstrdup(hint) : NULL;
+
+  for (int i = 0; i < total_checks; i++) {
+    entry->checks[i]               = checks[i];
+    entry->checks[i].selected_cols = bms_copy(checks[i].selected_cols);
+    entry->checks[i].inserted_cols = bms_copy(checks[i].inserted_cols);
+    entry->checks[i].updated_cols  = bms_copy(checks[i].updated_cols);
+  }
+
+  MemoryContextSwitchTo(oldcxt);
+
+  return hint;
+}
@@ -3,12 +3,21 @@
 
 #include "pg_prelude.h"
 
-typedef struct {
-  Oid     relid;
-  AclMode acl;
-} missing_perm;
+/**
+ * Register the invalidation of the cached hints. Must be called from
+ * _PG_init().
+ */
+extern void init_permission_hints(void);
 
-missing_perm find_missing_perm(PlannedStmt *ps, Oid current_role_oid);
-void         build_privileges_string(StringInfo buf, AclMode missing_perms);
+/**
+ * The hint for a plan that failed with ERRCODE_INSUFFICIENT_PRIVILEGE, with a
+ * GRANT of the first privileges the role is missing, or NULL when there's no
+ * hint for it. `relid` is set to the relation missing the privileges.
+ *
+ * Hints are cached per role and permission checks of the plan, so retrying
+ * the same statement doesn't walk the ACLs again.
+ */
+extern char *find_permission_hint(PlannedStmt *ps, Oid current_role_oid,
+                                  Oid *relid);
 
 #endif /* PERMISSION_HINTS_H */
@@ -6,45 +6,107 @@
 #pragma GCC diagnostic ignored "-Wunused-parameter"
 #pragma GCC diagnostic ignored "-Wsign-compare"
 
-#include <postgres.h>
-
-#include <access/htup_details.h>
-#include <access/xact.h>
-#include <catalog/namespace.h>
-#include <catalog/pg_authid.h>
-#include <catalog/pg_collation_d.h>
-#include <catalog/pg_proc.h>
-#include <commands/defrem.h>
-#include <commands/event_trigger.h>
-#include <commands/publicationcmds.h>
-#include <common/jsonapi.h>
-#include <executor/executor.h>
-#include <executor/spi.h>
-#include <fmgr.h>
-#include <miscadmin.h>
-#include <nodes/bitmapset.h>
-#include <nodes/makefuncs.h>
-#include <nodes/parsenodes.h>
-#include <nodes/pg_list.h>
-#include <nodes/value.h>
-#include <parser/parse_func.h>
-#include <tcop/utility.h>
-#include <tsearch/ts_locale.h>
-#include <utils/acl.h>
-#include <utils/builtins.h>
-#include <utils/fmgrprotos.h>
-#include <utils/formatting.h>
-#include <utils/guc.h>
-#include <utils/guc_tables.h>
-#include <utils/json.h>
-#include <utils/jsonb.h>
-#include <utils/jsonfuncs.h>
-#include <utils/lsyscache.h>
-#include <utils/memutils.h>
-#include <utils/regproc.h>
-#include <utils/snapmgr.h>
-#include <utils/syscache.h>
-#include <utils/varlena.h>
+// the JSON config parsers are also built into the frontend config checker,
+// see tools/
+#ifdef FRONTEND
+
+#  include <postgres_fe.h>
+
+#  include <common/jsonapi.h>
+#  include <common/logging.h>
+#  include <mb/pg_wchar.h>
+#  include <portability/instr_time.h>
+
+#else
+
+#  include <postgres.h>
+
+#  include <access/htup_details.h>
+#  include <access/parallel.h>
+#  include <access/relation.h>
+#  include <access/table.h>
+#  include <access/xact.h>
+#  include <catalog/dependency.h>
+#  include <catalog/index.h>
+#  include <catalog/indexing.h>
+#  include <catalog/namespace.h>
+#  include <catalog/objectaccess.h>
+#  include <catalog/pg_auth_members.h>
+#  include <catalog/pg_authid.h>
+#  include <catalog/pg_class.h>
+#  include <catalog/pg_collation_d.h>
+#  include <catalog/pg_event_trigger.h>
+#  include <catalog/pg_foreign_data_wrapper.h>
+#  include <catalog/pg_inherits.h>
+#  include <catalog/pg_proc.h>
+#  include <commands/defrem.h>
+#  include <commands/event_trigger.h>
+#  include <commands/publicationcmds.h>
+#  include <commands/tablecmds.h>
+#  include <commands/user.h>
+#  include <common/hashfn.h>
+#  include <common/jsonapi.h>
+#  include <executor/executor.h>
+#  include <executor/spi.h>
+#  include <fmgr.h>
+#  include <funcapi.h>
+#  include <miscadmin.h>
+#  include <nodes/bitmapset.h>
+#  include <nodes/makefuncs.h>
+#  include <nodes/parsenodes.h>
+#  include <nodes/pg_list.h>
+#  include <nodes/value.h>
+#  include <parser/parse_func.h>
+#  include <parser/parser.h>
+#  include <pgstat.h>
+#  include <port/atomics.h>
+#  include <port/pg_bitutils.h>
+#  include <portability/instr_time.h>
+#  include <postmaster/bgworker.h>
+#  include <postmaster/interrupt.h>
+#  include <replication/walsender.h>
+#  include <storage/bufmgr.h>
+#  include <storage/condition_variable.h>
+#  include <storage/fd.h>
+#  include <storage/ipc.h>
+#  include <storage/latch.h>
+#  include <storage/lmgr.h>
+#  include <storage/lwlock.h>
+#  include <storage/proc.h>
+#  include <storage/shmem.h>
+#  include <storage/spin.h>
+#  include <tcop/cmdtag.h>
+#  include <tcop/utility.h>
+#  include <tsearch/ts_locale.h>
+#  include <utils/acl.h>
+#  include <utils/builtins.h>
+#  include <utils/fmgrprotos.h>
+#  include <utils/formatting.h>
+#  include <utils/guc.h>
+#  include <utils/guc_tables.h>
+#  include <utils/inval.h>
+#  include <utils/json.h>
+#  include <utils/jsonb.h>
+#  include <utils/jsonfuncs.h>
+#  include <utils/lsyscache.h>
+#  include <utils/memutils.h>
+#  include <utils/regproc.h>
+#  include <utils/resowner.h>
+#  include <utils/snapmgr.h>
+#  include <utils/syscache.h>
+#  include <utils/timestamp.h>
+#  include <utils/tuplestore.h>
+#  include <utils/varlena.h>
+
+#  if PG_VERSION_NUM >= 170000
+#    include <storage/dsm_registry.h>
+#  endif
+
+#  if PG_VERSION_NUM >= 180000
+#    include <utils/pgstat_internal.h>
+#  endif
+
+#endif
 
 #pragma GCC diagnostic pop
 
@@ -52,19 +114,32 @@
 #define PG15_GTE (PG_VERSION_NUM >= 150000)
 #define PG16_GTE (PG_VERSION_NUM >= 160000)
 #define PG17_GTE (PG_VERSION_NUM >= 170000)
+#define PG18_GTE (PG_VERSION_NUM >= 180000)
 #define PG17_LT (PG_VERSION_NUM < 170000)
 #define PG16_LT (PG_VERSION_NUM < 160000)
+#define PG15_LT (PG_VERSION_NUM < 150000)
 
 #if PG17_GTE
 
 #  define NEW_JSON_LEX_CONTEXT_CSTRING_LEN(a, b, c, d)                         \
     makeJsonLexContextCstringLen(NULL, a, b, c, d)
+#  define FREE_JSON_LEX_CONTEXT(lex) freeJsonLexContext(lex)
 
 #else
 
 #  define NEW_JSON_LEX_CONTEXT_CSTRING_LEN(a, b, c, d)                         \
     makeJsonLexContextCstringLen(a, b, c, d)
 
+// freeJsonLexContext() is new in pg 17, the lexer owns only its string buffer
+#  define FREE_JSON_LEX_CONTEXT(lex)                                           \
+    do {                                                                       \
+      if ((lex)->strval != NULL) {                                             \
+        pfree((lex)->strval->data);                                            \
+        pfree((lex)->strval);                                                  \
+      }                                                                        \
+      pfree(lex);                                                              \
+    } while (0)
+
 #endif
 
 #if PG16_GTE
@@ -102,12 +177,17 @@
 
 #endif
 
+// utility_timer must be in scope, the chained hooks are excluded from it
 #define run_process_utility_hook(process_utility_hook)                         \
-  if (process_utility_hook != NULL) {                                          \
-    process_utility_hook(PROCESS_UTILITY_ARGS);                                \
-  } else {                                                                     \
-    standard_ProcessUtility(PROCESS_UTILITY_ARGS);                             \
-  }
+  do {                                                                         \
+    hook_timer_pause(utility_timer);                                           \
+    if (process_utility_hook != NULL) {                                        \
+      process_utility_hook(PROCESS_UTILITY_ARGS);                              \
+    } else {                                                                   \
+      standard_ProcessUtility(PROCESS_UTILITY_ARGS);                           \
+    }                                                                          \
+    hook_timer_resume(utility_timer);                                          \
+  } while (0)
 
 #define run_process_utility_hook_with_cleanup(process_utility_hook,            \
                                               already_switched_to_superuser,   \
@@ -121,7 +201,7 @@
     if (!(already_switched_to_superuser)) {                                    \
       switch_to_original_role();                                               \
     }                                                                          \
-    PG_RE_THROW();                                                             \
+    rethrow_escalated_error();                                                 \
   }                                                                            \
   PG_END_TRY();
 
@@ -0,0 +1,239 @@
+#include "pg_prelude.h"
+
+#include "placeholders.h"
+
+// Poolers and PostgREST set the same values (e.g. the JWT claims) over and
+// over on a backend. ASCII values are scanned in a single pass, but the others
+// are lowercased with the collation first, so the last of those accepted are
+// remembered
+#define ACCEPTED_CACHE_SIZE 8
+#define ACCEPTED_MAX_LEN    16384
+
+typedef struct {
+  uint32 hash;
+  Size   len;
+  char  *value;
+} accepted_value;
+
+// Aho-Corasick automaton over the disallowed values, expanded into a DFA so
+// scanning takes a single table lookup per byte. Bytes are mapped to classes
+// (bytes not in any value share class 0) to keep the table small.
+struct disallowed_values {
+  char         **tokens;
+  int            total_tokens;
+  // an empty value is contained in every string
+  int            empty_token;
+  uint8          byte_class[256];
+  int            total_classes;
+  int            total_states;
+  // next state, indexed by [state * total_classes + class]
+  int           *transitions;
+  // smallest index of the tokens matched on reaching a state, or -1
+  int           *first_match;
+  // the cache is dropped with the automaton on reload
+  MemoryContext  cxt;
+  accepted_value accepted[ACCEPTED_CACHE_SIZE];
+  int            next_accepted;
+};
+
+static bool has_ascii_upper(const char *str) {
+  for (; *str; str++)
+    if (*str >= 'A' && *str <= 'Z') return true;
+
+  return false;
+}
+
+disallowed_values *compile_disallowed_values(const char   *str,
+                                             MemoryContext cxt) {
+  MemoryContext      oldcxt = MemoryContextSwitchTo(cxt);
+  disallowed_values *dv     = palloc0(sizeof(disallowed_values));
+  char              *string = pstrdup(str);
+  char              *token;
+  int                max_states = 1;
+  int               *fail, *queue;
+  int                head = 0, tail = 0;
+
+  dv->cxt          = cxt;
+  dv->empty_token  = -1;
+  dv->total_tokens = 1;
+  for (const char *c = str; *c; c++)
+    if (*c == ',') dv->total_tokens++;
+
+  dv->tokens = palloc(sizeof(char *) * dv->total_tokens);
+
+  // the values are taken verbatim, without trimming spaces or quotes
+  for (int i = 0; (token = strsep(&string, ",")) != NULL; i++) {
+    dv->tokens[i] = token;
+    max_states += strlen(token);
+  }
+
+  // Values with uppercase letters can never be contained in a lowercased
+  // string so they're left out of the automaton
+  dv->total_classes = 1;
+  for (int i = 0; i < dv->total_tokens; i++) {
+    if (has_ascii_upper(dv->tokens[i])) continue;
+
+    for (const unsigned char *c = (unsigned char *)dv->tokens[i]; *c; c++)
+      if (dv->byte_class[*c] == 0) dv->byte_class[*c] = dv->total_classes++;
+  }
+
+  // so ASCII strings can be scanned without lowercasing them first
+  for (int c = 'A'; c <= 'Z'; c++)
+    dv->byte_class[c] = dv->byte_class[c - 'A' + 'a'];
+
+  dv->transitions = palloc(sizeof(int) * max_states * dv->total_classes);
+  dv->first_match = palloc(sizeof(int) * max_states);
+  memset(dv->transitions, -1, sizeof(int) * max_states * dv->total_classes);
+  memset(dv->first_match, -1, sizeof(int) * max_states);
+
+  // build the trie
+  dv->total_states = 1;
+  for (int i = 0; i < dv->total_tokens; i++) {
+    int state = 0;
+
+    if (dv->tokens[i][0] == '\0') {
+      if (dv->empty_token < 0) dv->empty_token = i;
+      continue;
+    }
+
+    if (has_ascii_upper(dv->tokens[i])) continue;
+
+    for (const unsigned char *c = (unsigned char *)dv->tokens[i]; *c; c++) {
+      int *next =
+          &dv->transitions[state * dv->total_classes + dv->byte_class[*c]];
+
+      if (*next < 0) *next = dv->total_states++;
+      state = *next;
+    }
+
+    if (dv->first_match[state] < 0) dv->first_match[state] = i;
+  }
+
+  // fill the failure transitions breadth-first, so the failure state of every
+  // state is complete before the state itself
+  fail  = palloc0(sizeof(int) * dv->total_states);
+  queue = palloc(sizeof(int) * dv->total_states);
+
+  for (int c = 0; c < dv->total_classes; c++) {
+    int *next = &dv->transitions[c];
+
+    if (*next < 0)
+      *next = 0;
+    else
+      queue[tail++] = *next;
+  }
+
+  while (head < tail) {
+    int state     = queue[head++];
+    int inherited = dv->first_match[fail[state]];
+
+    // the values that end at the failure state are suffixes of this one
+    if (inherited >= 0 &&
+        (dv->first_match[state] < 0 || inherited < dv->first_match[state]))
+      dv->first_match[state] = inherited;
+
+    for (int c = 0; c < dv->total_classes; c++) {
+      int *next = &dv->transitions[state * dv->total_classes + c];
+      int  fallback = dv->transitions[fail[state] * dv->total_classes + c];
+
+      if (*next < 0)
+        *next = fallback;
+      else {
+        fail[*next]   = fallback;
+        queue[tail++] = *next;
+      }
+    }
+  }
+
+  pfree(fail);
+  pfree(queue);
+
+  MemoryContextSwitchTo(oldcxt);
+
+  return dv;
+}
+
+// Returns the smallest index of the tokens contained in val, or -1. When
+// ascii_only it stops on the first non-ASCII byte and sets *non_ascii.
+static int first_token_in(const disallowed_values *dv, const char *val,
+                          bool ascii_only, bool *non_ascii) {
+  int best  = dv->empty_token;
+  int state = 0;
+
+  for (const unsigned char *c = (unsigned char *)val; *c && best != 0; c++) {
+    int match;
+
+    if (ascii_only && IS_HIGHBIT_SET(*c)) {
+      *non_ascii = true;
+      return -1;
+    }
+
+    state = dv->transitions[state * dv->total_classes + dv->byte_class[*c]];
+    match = dv->first_match[state];
+
+    if (match >= 0 && (best < 0 || match < best)) best = match;
+  }
+
+  return best;
+}
+
+static bool is_accepted(const disallowed_values *dv, const char *val, Size len,
+                        uint32 hash) {
+  for (int i = 0; i < ACCEPTED_CACHE_SIZE; i++) {
+    const accepted_value *a = &dv->accepted[i];
+
+    // the hash is only a filter, the value is compared so a collision can't
+    // pass a disallowed value
+    if (a->value != NULL && a->hash == hash && a->len == len &&
+        memcmp(a->value, val, len) == 0)
+      return true;
+  }
+
+  return false;
+}
+
+static void remember_accepted(disallowed_values *dv, const char *val, Size len,
+                              uint32 hash) {
+  accepted_value *a = &dv->accepted[dv->next_accepted];
+
+  if (a->value != NULL) pfree(a->value);
+
+  a->hash  = hash;
+  a->len   = len;
+  a->value = MemoryContextAlloc(dv->cxt, len);
+  memcpy(a->value, val, len);
+
+  dv->next_accepted = (dv->next_accepted + 1) % ACCEPTED_CACHE_SIZE;
+}
+
+const char *find_disallowed_value(disallowed_values *dv, const char *val) {
+  Size   len;
+  bool   cacheable;
+  uint32 hash      = 0;
+  bool   non_ascii = false;
+  char  *lower;
+  int    found;
+
+  found = first_token_in(dv, val, true, &non_ascii);
+
+  if (!non_ascii) return found >= 0 ? dv->tokens[found] : NULL;
+
+  len       = strlen(val);
+  cacheable = len <= ACCEPTED_MAX_LEN;
+
+  if (cacheable) {
+    hash = hash_bytes((const unsigned char *)val, len);
+    if (is_accepted(dv, val, len, hash)) return NULL;
+  }
+
+  // lowercasing non-ASCII characters depends on the collation
+  lower = str_tolower(val, len, DEFAULT_COLLATION_OID);
+  found = first_token_in(dv, lower, false, &non_ascii);
+  pfree(lower);
+
+  if (found >= 0) return dv->tokens[found];
+
+  if (cacheable) remember_accepted(dv, val, len, hash);
+
+  return NULL;
+}
@@ -0,0 +1,23 @@
+#ifndef PLACEHOLDERS_H
+#define PLACEHOLDERS_H
+
+#include "pg_prelude.h"
+
+typedef struct disallowed_values disallowed_values;
+
+/**
+ * Compile a comma-separated list of disallowed values into an automaton that
+ * finds all of them in a single pass. The result is allocated in cxt.
+ */
+extern disallowed_values *compile_disallowed_values(const char   *str,
+                                                    MemoryContext cxt);
+
+/**
+ * Returns the first disallowed value (in list order) contained in the
+ * lowercased val, or NULL if there's none. The last accepted values that
+ * needed lowercasing with the collation are cached in dv.
+ */
+extern const char *find_disallowed_value(disallowed_values *dv,
+                                         const char        *val);
+
+#endif
@@ -1,7 +1,7 @@
 #include "pg_prelude.h"
 
+#include "memory.h"
 #include "policy_grants.h"
-#include "utils.h"
 
 static JSON_ACTION_RETURN_TYPE json_array_start(void *state) {
   json_policy_grants_parse_state *parse = state;
@@ -69,12 +69,20 @@ json_object_field_start(void *state, char *fname,
 
   switch (parse->state) {
   case JPG_EXPECT_TOPLEVEL_FIELD:
-    x->role_name = MemoryContextStrdup(TopMemoryContext, fname);
+    if (parse->total_pgs >= MAX_POLICY_GRANTS) {
+      parse->state     = JPG_TOO_MANY_ROLES;
+      parse->error_msg = "too many roles, the maximum is "
+                         CppAsString2(MAX_POLICY_GRANTS);
+      break;
+    }
+    x->role_name =
+        MemoryContextStrdup(get_memory_context(MEMCXT_POLICY_GRANTS), fname);
     parse->state = JPG_EXPECT_TABLES_START;
     break;
 
   default: break;
   }
+  pfree(fname);
   JSON_ACTION_RETURN;
 }
 
@@ -85,9 +93,13 @@ static JSON_ACTION_RETURN_TYPE json_scalar(void *state, char *token,
 
   switch (parse->state) {
   case JPG_EXPECT_TABLE:
-    if (tokentype == JSON_TOKEN_STRING) {
-      x->table_names[x->total_tables] =
-          MemoryContextStrdup(TopMemoryContext, token);
+    if (x->total_tables >= MAX_POLICY_GRANT_TABLES) {
+      parse->state     = JPG_TOO_MANY_TABLES;
+      parse->error_msg = "too many tables for a role, the maximum is "
+                         CppAsString2(MAX_POLICY_GRANT_TABLES);
+    } else if (tokentype == JSON_TOKEN_STRING) {
+      x->table_names[x->total_tables] = MemoryContextStrdup(
+          get_memory_context(MEMCXT_POLICY_GRANTS), token);
       x->total_tables++;
     } else {
       parse->state     = JPG_UNEXPECTED_TABLE_VALUE;
@@ -107,6 +119,7 @@ static JSON_ACTION_RETURN_TYPE json_scalar(void *state, char *token,
 
   default: break;
   }
+  pfree(token);
   JSON_ACTION_RETURN;
 }
 
@@ -115,12 +128,12 @@ json_policy_grants_parse_state parse_policy_grants(const char    *str,
   JsonLexContext    *lex;
   JsonParseErrorType json_error;
   JsonSemAction      sem;
+  char              *json = pstrdup(str);
 
   json_policy_grants_parse_state state = {JPG_EXPECT_TOPLEVEL_START, NULL, 0,
                                           pgs};
 
-  lex = NEW_JSON_LEX_CONTEXT_CSTRING_LEN(pstrdup(str), strlen(str), PG_UTF8,
-                                         true);
+  lex = NEW_JSON_LEX_CONTEXT_CSTRING_LEN(json, strlen(json), PG_UTF8, true);
 
   sem.semstate            = &state;
   sem.object_start        = json_object_start;
@@ -137,16 +150,23 @@ json_policy_grants_parse_state parse_policy_grants(const char    *str,
 
   if (json_error != JSON_SUCCESS) state.error_msg = "invalid json";
 
+  FREE_JSON_LEX_CONTEXT(lex);
+  pfree(json);
+
   return state;
 }
 
+#ifndef FRONTEND
+
 bool is_current_role_granted_table_policy(const RangeVar      *table_range_var,
+                                          stmt_context        *ctx,
                                           const policy_grants *pgs,
-                                          const size_t         total_pgs) {
+                                          const size_t         total_pgs,
+                                          LOCKMODE             lockmode) {
 
   Oid target_table_id =
-      RangeVarGetRelid(table_range_var, AccessExclusiveLock, false);
-  char *current_role_name = GetUserNameFromId(GetUserId(), false);
+      RangeVarGetRelid(table_range_var, lockmode, false);
+  const char *current_role_name = stmt_role_name(ctx);
 
   for (size_t i = 0; i < total_pgs; i++) {
     const policy_grants *pg = &pgs[i];
@@ -171,7 +191,7 @@ bool is_current_role_granted_table_policy(const RangeVar      *table_range_var,
       }
 
       range_var = makeRangeVarFromNameList(qual_name_list);
-      table_id  = RangeVarGetRelid(range_var, AccessExclusiveLock, true);
+      table_id  = RangeVarGetRelid(range_var, lockmode, true);
       if (!OidIsValid(table_id)) {
         continue;
       }
@@ -184,3 +204,5 @@ bool is_current_role_granted_table_policy(const RangeVar      *table_range_var,
 
   return false;
 }
+
+#endif
@@ -1,10 +1,13 @@
 #ifndef POLICY_GRANTS_H
 #define POLICY_GRANTS_H
 
-#include <postgres.h>
+#include "pg_prelude.h"
 
-#include <catalog/namespace.h>
+#ifndef FRONTEND
+#  include "utils.h"
+#endif
 
+#define MAX_POLICY_GRANTS 100
 #define MAX_POLICY_GRANT_TABLES 100
 
 typedef struct {
@@ -21,7 +24,9 @@ typedef enum {
   JPG_UNEXPECTED_ARRAY,
   JPG_UNEXPECTED_SCALAR,
   JPG_UNEXPECTED_OBJECT,
-  JPG_UNEXPECTED_TABLE_VALUE
+  JPG_UNEXPECTED_TABLE_VALUE,
+  JPG_TOO_MANY_ROLES,
+  JPG_TOO_MANY_TABLES
 } json_policy_grants_semantic_state;
 
 typedef struct {
@@ -34,9 +39,15 @@ typedef struct {
 extern json_policy_grants_parse_state parse_policy_grants(const char    *str,
                                                           policy_grants *pgs);
 
+#ifndef FRONTEND
+
 extern bool
 is_current_role_granted_table_policy(const RangeVar      *table_range_var,
+                                     stmt_context        *ctx,
                                      const policy_grants *pgs,
-                                     const size_t         total_pgs);
+                                     const size_t         total_pgs,
+                                     LOCKMODE             lockmode);
+
+#endif
 
 #endif
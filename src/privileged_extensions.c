@@ -1,22 +1,6 @@
+#include "extension_registry.h"
 #include "privileged_extensions.h"
 
-bool all_extensions_are_privileged(List       *objects,
-                                   const char *privileged_extensions) {
-  ListCell *lc;
-
-  if (privileged_extensions == NULL) return false;
-
-  foreach (lc, objects) {
-    char *name = strVal(lfirst(lc));
-
-    if (!is_extension_privileged(name, privileged_extensions)) {
-      return false;
-    }
-  }
-
-  return true;
-}
-
 bool is_extension_privileged(const char *extname,
                              const char *privileged_extensions) {
   if (privileged_extensions == NULL) return false;
@@ -29,10 +13,17 @@ bool is_extension_privileged(const char *extname,
  * Returns true if the extension is present in the pg_available_extensions
  * view, false otherwise. Only those extensions are present in this view
  * which have their control files on disk.
+ *
+ * The extension registry answers for the extensions it has indexed, without
+ * SPI or a directory scan. A miss still goes through the view, the registry
+ * lags behind extensions installed since its last scan.
  */
 bool is_extension_available(const char *extname) {
-  int  ret;
-  bool found = false;
+  int            ret;
+  bool           found = false;
+  extension_info info;
+
+  if (lookup_extension(extname, &info) == REGISTRY_FOUND) return true;
 
   Assert(ActiveSnapshotSet());
 
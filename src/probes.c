@@ -0,0 +1,13 @@
+#include "pg_prelude.h"
+
+#include "probes.h"
+
+#ifdef USE_USDT
+
+// The semaphores of the probes, in the section where the tracers look for them
+#  define SUPAUTILS_PROBE_SEMAPHORE_DEF(name)                                  \
+    unsigned short supautils_##name##_semaphore                                \
+        __attribute__((unused, section(".probes"))) = 0;
+SUPAUTILS_PROBE_SEMAPHORES(SUPAUTILS_PROBE_SEMAPHORE_DEF)
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+// Static (USDT) probes, compiled in with `make USDT=1`. They need the
+// systemtap sdt headers and can be listed with:
+//
+//   bpftrace -l 'usdt:/path/to/supautils.so:*'
+//
+// Without USDT=1 the probes compile to nothing and their arguments are not
+// evaluated. With it the arguments are evaluated even when no tracer is
+// attached, so a costly one is only computed when
+// TRACE_SUPAUTILS_<PROBE>_ENABLED() is true. The query text is never passed,
+// it can hold secrets such as the password of a CREATE ROLE.
+#ifdef USE_USDT
+
+// every probe then has a semaphore, set by the tracers attached to it, they're
+// defined in probes.c
+#  define _SDT_HAS_SEMAPHORES 1
+#  include <sys/sdt.h>
+
+#  define SUPAUTILS_PROBE_SEMAPHORES(X)                                        \
+    X(utility__start)                                                          \
+    X(utility__done)                                                           \
+    X(superuser__switch)                                                       \
+    X(superuser__restore)                                                      \
+    X(evtrig__execute)                                                         \
+    X(evtrig__skip)                                                            \
+    X(hint__start)                                                             \
+    X(hint__done)                                                              \
+    X(custom__script__start)                                                   \
+    X(custom__script__done)
+
+#  define SUPAUTILS_PROBE_SEMAPHORE_DECL(name)                                 \
+    extern unsigned short supautils_##name##_semaphore;
+SUPAUTILS_PROBE_SEMAPHORES(SUPAUTILS_PROBE_SEMAPHORE_DECL)
+
+#  define TRACE_SUPAUTILS_UTILITY_START_ENABLED()                              \
+    __builtin_expect(supautils_utility__start_semaphore != 0, 0)
+#  define TRACE_SUPAUTILS_UTILITY_DONE_ENABLED()                               \
+    __builtin_expect(supautils_utility__done_semaphore != 0, 0)
+
+#  define TRACE_SUPAUTILS_UTILITY_START(node_tag, role_oid, object)            \
+    DTRACE_PROBE3(supautils, utility__start, node_tag, role_oid, object)
+#  define TRACE_SUPAUTILS_UTILITY_DONE(node_tag, role_oid, object)             \
+    DTRACE_PROBE3(supautils, utility__done, node_tag, role_oid, object)
+#  define TRACE_SUPAUTILS_SUPERUSER_SWITCH(role_oid, superuser_oid)            \
+    DTRACE_PROBE2(supautils, superuser__switch, role_oid, superuser_oid)
+#  define TRACE_SUPAUTILS_SUPERUSER_RESTORE(role_oid)                          \
+    DTRACE_PROBE1(supautils, superuser__restore, role_oid)
+#  define TRACE_SUPAUTILS_EVTRIG_EXECUTE(role_oid, func_name)                  \
+    DTRACE_PROBE2(supautils, evtrig__execute, role_oid, func_name)
+#  define TRACE_SUPAUTILS_EVTRIG_SKIP(role_oid, func_name)                     \
+    DTRACE_PROBE2(supautils, evtrig__skip, role_oid, func_name)
+#  define TRACE_SUPAUTILS_HINT_START(role_oid)                                 \
+    DTRACE_PROBE1(supautils, hint__start, role_oid)
+#  define TRACE_SUPAUTILS_HINT_DONE(role_oid, relid, hint_added)               \
+    DTRACE_PROBE3(supautils, hint__done, role_oid, relid, hint_added)
+#  define TRACE_SUPAUTILS_CUSTOM_SCRIPT_START(role_oid, extname, filename)     \
+    DTRACE_PROBE3(supautils, custom__script__start, role_oid, extname,         \
+                  filename)
+#  define TRACE_SUPAUTILS_CUSTOM_SCRIPT_DONE(role_oid, extname, filename)      \
+    DTRACE_PROBE3(supautils, custom__script__done, role_oid, extname, filename)
+
+#else
+
+#  define TRACE_SUPAUTILS_UTILITY_START_ENABLED() (false)
+#  define TRACE_SUPAUTILS_UTILITY_DONE_ENABLED()  (false)
+
+#  define TRACE_SUPAUTILS_UTILITY_START(node_tag, role_oid, object)            \
+    do {                                                                       \
+    } while (0)
+#  define TRACE_SUPAUTILS_UTILITY_DONE(node_tag, role_oid, object)             \
+    do {                                                                       \
+    } while (0)
+#  define TRACE_SUPAUTILS_SUPERUSER_SWITCH(role_oid, superuser_oid)            \
+    do {                                                                       \
+    } while (0)
+#  define TRACE_SUPAUTILS_SUPERUSER_RESTORE(role_oid)                          \
+    do {                                                                       \
+    } while (0)
+#  define TRACE_SUPAUTILS_EVTRIG_EXECUTE(role_oid, func_name)                  \
+    do {                                                                       \
+    } while (0)
+#  define TRACE_SUPAUTILS_EVTRIG_SKIP(role_oid, func_name)                     \
+    do {                                                                       \
+    } while (0)
+#  define TRACE_SUPAUTILS_HINT_START(role_oid)                                 \
+    do {                                                                       \
+    } while (0)
+#  define TRACE_SUPAUTILS_HINT_DONE(role_oid, relid, hint_added)               \
+    do {                                                                       \
+    } while (0)
+#  define TRACE_SUPAUTILS_CUSTOM_SCRIPT_START(role_oid, extname, filename)     \
+    do {                                                                       \
+    } while (0)
+#  define TRACE_SUPAUTILS_CUSTOM_SCRIPT_DONE(role_oid, extname, filename)      \
+    do {                                                                       \
+    } while (0)
+
+#endif
+
+#endif
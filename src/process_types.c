@@ -0,0 +1,68 @@
+#include "pg_prelude.h"
+
+#include "process_types.h"
+
+static const struct {
+  const char  *name;
+  process_type type;
+} process_type_names[] = {
+  {"parallel_worker", PROCESS_PARALLEL_WORKER},
+  {"autovacuum", PROCESS_AUTOVACUUM},
+  {"walsender", PROCESS_WALSENDER},
+  {"background_worker", PROCESS_BACKGROUND_WORKER},
+};
+
+// the type of a process doesn't change, so it's only computed once
+static int my_process_type = -1;
+
+bool parse_process_types(const char *str, int *types, const char **unknown) {
+  List     *names;
+  ListCell *lc;
+
+  *types = 0;
+
+  if (!SplitIdentifierString(pstrdup(str), ',', &names)) {
+    *unknown = str;
+    return false;
+  }
+
+  foreach (lc, names) {
+    const char *name  = lfirst(lc);
+    bool        found = false;
+
+    for (size_t i = 0; i < lengthof(process_type_names); i++) {
+      if (strcmp(name, process_type_names[i].name) == 0) {
+        *types |= process_type_names[i].type;
+        found = true;
+        break;
+      }
+    }
+
+    if (!found) {
+      *unknown = name;
+      list_free(names);
+      return false;
+    }
+  }
+
+  list_free(names);
+
+  return true;
+}
+
+int current_process_type(void) {
+  if (my_process_type >= 0) return my_process_type;
+
+  if (IsParallelWorker())
+    my_process_type = PROCESS_PARALLEL_WORKER;
+  else if (MyBackendType == B_AUTOVAC_WORKER)
+    my_process_type = PROCESS_AUTOVACUUM;
+  else if (am_walsender)
+    my_process_type = PROCESS_WALSENDER;
+  else if (MyBackendType == B_BG_WORKER)
+    my_process_type = PROCESS_BACKGROUND_WORKER;
+  else
+    my_process_type = 0;
+
+  return my_process_type;
+}
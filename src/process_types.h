@@ -0,0 +1,25 @@
+#ifndef PROCESS_TYPES_H
+#define PROCESS_TYPES_H
+
+#include "pg_prelude.h"
+
+typedef enum {
+  PROCESS_PARALLEL_WORKER   = 1 << 0,
+  PROCESS_AUTOVACUUM        = 1 << 1,
+  PROCESS_WALSENDER         = 1 << 2,
+  PROCESS_BACKGROUND_WORKER = 1 << 3,
+} process_type;
+
+/**
+ * Parse a comma-separated list of process types into a bitmask of
+ * process_type. Returns false and sets *unknown if a name is not recognized.
+ */
+extern bool parse_process_types(const char *str, int *types,
+                                const char **unknown);
+
+/**
+ * The process_type of the current process, 0 for client backends.
+ */
+extern int current_process_type(void);
+
+#endif
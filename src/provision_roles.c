@@ -0,0 +1,187 @@
+#include "pg_prelude.h"
+
+#include "provision_roles.h"
+
+#define EREPORT_INVALID_ROLES(msg)                                             \
+  ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),                    \
+                  errmsg("supautils_provision_roles: %s", msg)))
+
+static char *jsonb_string(const JsonbValue *v) {
+  return pnstrdup(v->val.string.val, v->val.string.len);
+}
+
+static List *parse_member_of(const JsonbValue *v) {
+  List *member_of = NIL;
+  int   count;
+
+  if (v->type != jbvBinary || !JsonContainerIsArray(v->val.binary.data))
+    EREPORT_INVALID_ROLES("\"member_of\" must be an array of role names");
+
+  count = JsonContainerSize(v->val.binary.data);
+
+  for (int i = 0; i < count; i++) {
+    JsonbValue *elem = getIthJsonbValueFromContainer(v->val.binary.data, i);
+
+    if (elem->type != jbvString)
+      EREPORT_INVALID_ROLES("\"member_of\" must be an array of role names");
+
+    member_of = lappend(member_of, jsonb_string(elem));
+  }
+
+  return member_of;
+}
+
+List *parse_provisioned_roles(Jsonb *jb) {
+  List *roles = NIL;
+  int   count;
+
+  if (!JB_ROOT_IS_ARRAY(jb) || JB_ROOT_IS_SCALAR(jb))
+    EREPORT_INVALID_ROLES("expected an array of roles");
+
+  count = JB_ROOT_COUNT(jb);
+
+  for (int i = 0; i < count; i++) {
+    JsonbValue       *elem = getIthJsonbValueFromContainer(&jb->root, i);
+    provisioned_role *role = palloc0(sizeof(provisioned_role));
+    JsonbContainer   *container;
+    JsonbValue        v;
+
+    if (elem->type != jbvBinary ||
+        !JsonContainerIsObject(elem->val.binary.data))
+      EREPORT_INVALID_ROLES("each role must be an object");
+
+    container = elem->val.binary.data;
+
+    if (!getKeyJsonValueFromContainer(container, "role", strlen("role"), &v) ||
+        v.type != jbvString || v.val.string.len == 0)
+      EREPORT_INVALID_ROLES("each role must have a non-empty \"role\" name");
+
+    role->name = jsonb_string(&v);
+
+    if (getKeyJsonValueFromContainer(container, "login", strlen("login"),
+                                     &v)) {
+      if (v.type != jbvBool)
+        EREPORT_INVALID_ROLES("\"login\" must be a boolean");
+
+      role->login = v.val.boolean;
+    }
+
+    if (getKeyJsonValueFromContainer(container, "member_of",
+                                     strlen("member_of"), &v))
+      role->member_of = parse_member_of(&v);
+
+    roles = lappend(roles, role);
+  }
+
+  return roles;
+}
+
+static RoleSpec *make_rolespec(char *name) {
+  RoleSpec *spec = makeNode(RoleSpec);
+
+  spec->roletype = ROLESPEC_CSTRING;
+  spec->rolename = name;
+  spec->location = -1;
+
+  return spec;
+}
+
+static void append_role_names(StringInfo buf, List *names) {
+  ListCell *lc;
+
+  foreach (lc, names) {
+    if (lc != list_head(names)) appendStringInfoString(buf, ", ");
+    appendStringInfoString(buf, quote_identifier(lfirst(lc)));
+  }
+}
+
+// Run a statement built here like one of a function body, so the utility
+// hooks, like supautils.audit or pgaudit, see it. `query` is the SQL it was
+// built from.
+static void run_provisioning_stmt(Node *stmt, const char *query) {
+  PlannedStmt *pstmt = makeNode(PlannedStmt);
+
+  pstmt->commandType   = CMD_UTILITY;
+  pstmt->canSetTag     = false;
+  pstmt->utilityStmt   = stmt;
+  pstmt->stmt_location = -1;
+  pstmt->stmt_len      = 0;
+
+  ProcessUtility(pstmt, query,
+#if PG14_GTE
+                 false,
+#endif
+                 PROCESS_UTILITY_QUERY, NULL, NULL, None_Receiver, NULL);
+
+  CommandCounterIncrement();
+}
+
+void create_provisioned_role(const provisioned_role *role) {
+  CreateRoleStmt *stmt      = makeNode(CreateRoleStmt);
+  List           *addroleto = NIL;
+  ListCell       *lc;
+  StringInfoData  query;
+
+  stmt->stmt_type = ROLESTMT_ROLE;
+  stmt->role      = role->name;
+
+#if PG15_GTE
+  stmt->options = list_make1(
+      makeDefElem("canlogin", (Node *)makeBoolean(role->login), -1));
+#else
+  stmt->options = list_make1(
+      makeDefElem("canlogin", (Node *)makeInteger(role->login), -1));
+#endif
+
+  foreach (lc, role->member_of)
+    addroleto = lappend(addroleto, make_rolespec(lfirst(lc)));
+
+  if (addroleto != NIL)
+    stmt->options = lappend(stmt->options,
+                            makeDefElem("addroleto", (Node *)addroleto, -1));
+
+  initStringInfo(&query);
+  appendStringInfo(&query, "CREATE ROLE %s %s", quote_identifier(role->name),
+                   role->login ? "LOGIN" : "NOLOGIN");
+  if (role->member_of != NIL) {
+    appendStringInfoString(&query, " IN ROLE ");
+    append_role_names(&query, role->member_of);
+  }
+
+  run_provisioning_stmt((Node *)stmt, query.data);
+}
+
+bool grant_provisioned_memberships(const provisioned_role *role) {
+  GrantRoleStmt *stmt    = makeNode(GrantRoleStmt);
+  Oid            roleid  = get_role_oid(role->name, false);
+  List          *missing = NIL;
+  ListCell      *lc;
+  StringInfoData query;
+
+  // a membership held through another role already gives its privileges
+  foreach (lc, role->member_of) {
+    if (!is_member_of_role_nosuper(roleid, get_role_oid(lfirst(lc), false)))
+      missing = lappend(missing, lfirst(lc));
+  }
+
+  if (missing == NIL) return false;
+
+  foreach (lc, missing) {
+    AccessPriv *priv = makeNode(AccessPriv);
+
+    priv->priv_name     = lfirst(lc);
+    stmt->granted_roles = lappend(stmt->granted_roles, priv);
+  }
+
+  stmt->grantee_roles = list_make1(make_rolespec(role->name));
+  stmt->is_grant      = true;
+
+  initStringInfo(&query);
+  appendStringInfoString(&query, "GRANT ");
+  append_role_names(&query, missing);
+  appendStringInfo(&query, " TO %s", quote_identifier(role->name));
+
+  run_provisioning_stmt((Node *)stmt, query.data);
+
+  return true;
+}
@@ -0,0 +1,31 @@
+#ifndef PROVISION_ROLES_H
+#define PROVISION_ROLES_H
+
+#include "pg_prelude.h"
+
+typedef struct {
+  char *name;
+  bool  login;
+  List *member_of; // names of the roles to make this a member of
+} provisioned_role;
+
+/**
+ * Parse a jsonb array of roles like
+ * [{"role": "tenant", "login": true, "member_of": ["authenticated"]}]
+ * into a List of provisioned_role. Errors on invalid input.
+ */
+extern List *parse_provisioned_roles(Jsonb *jb);
+
+/**
+ * Create the role and its memberships as the current role. The statement goes
+ * through ProcessUtility like a CREATE ROLE, so the utility hooks see it.
+ */
+extern void create_provisioned_role(const provisioned_role *role);
+
+/**
+ * Grant an existing role the memberships it doesn't have yet, through
+ * ProcessUtility like a GRANT. Returns whether any membership was granted.
+ */
+extern bool grant_provisioned_memberships(const provisioned_role *role);
+
+#endif
@@ -0,0 +1,103 @@
+#include "pg_prelude.h"
+
+#include "memory.h"
+#include "reserved_memberships.h"
+
+typedef struct {
+  Oid role; // hash key
+  Oid reserved_role;
+} closure_entry;
+
+// Every role that is a member of a reserved membership, directly or through
+// other roles. Built on the first lookup after a role or membership change, so
+// each lookup is a single hash probe.
+static HTAB *closure       = NULL;
+static bool  closure_stale = true;
+
+static void
+closure_syscache_callback(__attribute__((unused)) Datum  arg,
+                          __attribute__((unused)) int    cacheid,
+                          __attribute__((unused)) uint32 hashvalue) {
+  closure_stale = true;
+}
+
+void init_reserved_memberships(void) {
+  CacheRegisterSyscacheCallback(AUTHMEMROLEMEM, closure_syscache_callback,
+                                (Datum)0);
+  // reserved roles can be created, renamed or dropped after the config is set
+  CacheRegisterSyscacheCallback(AUTHOID, closure_syscache_callback, (Datum)0);
+}
+
+void invalidate_reserved_memberships(void) { closure_stale = true; }
+
+// breadth-first walk over the members of the reserved role
+static void add_members(HTAB *htab, Oid reserved_role) {
+  List *pending = list_make1_oid(reserved_role);
+
+  while (pending != NIL) {
+    Oid       role = linitial_oid(pending);
+    CatCList *members;
+
+    pending = list_delete_first(pending);
+    members = SearchSysCacheList1(AUTHMEMROLEMEM, ObjectIdGetDatum(role));
+
+    for (int i = 0; i < members->n_members; i++) {
+      Form_pg_auth_members form =
+          (Form_pg_auth_members)GETSTRUCT(&members->members[i]->tuple);
+      closure_entry *entry;
+      bool           found;
+
+      entry = hash_search(htab, &form->member, HASH_ENTER, &found);
+      if (found) continue;
+
+      entry->reserved_role = reserved_role;
+      pending              = lappend_oid(pending, form->member);
+    }
+
+    ReleaseSysCacheList(members);
+  }
+}
+
+static void build_closure(const char *reserved_memberships) {
+  MemoryContext cxt = get_memory_context(MEMCXT_RESERVED_MEMBERSHIPS);
+  HASHCTL       ctl = {0};
+  HTAB         *htab;
+  List         *names;
+  ListCell     *lc;
+
+  MemoryContextReset(cxt);
+  closure = NULL;
+
+  // invalidations that arrive while building mark the new closure as stale
+  closure_stale = false;
+
+  ctl.keysize   = sizeof(Oid);
+  ctl.entrysize = sizeof(closure_entry);
+  ctl.hcxt      = cxt;
+  htab = hash_create("supautils reserved memberships", 64, &ctl,
+                     HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+  SplitIdentifierString(pstrdup(reserved_memberships), ',', &names);
+
+  foreach (lc, names) {
+    Oid reserved_role = get_role_oid(lfirst(lc), true);
+
+    if (OidIsValid(reserved_role)) add_members(htab, reserved_role);
+  }
+
+  list_free(names);
+
+  closure = htab;
+}
+
+Oid find_reserved_membership(Oid role, const char *reserved_memberships) {
+  closure_entry *entry;
+
+  if (reserved_memberships == NULL) return InvalidOid;
+
+  if (closure_stale || closure == NULL) build_closure(reserved_memberships);
+
+  entry = hash_search(closure, &role, HASH_FIND, NULL);
+
+  return entry != NULL ? entry->reserved_role : InvalidOid;
+}
@@ -0,0 +1,24 @@
+#ifndef RESERVED_MEMBERSHIPS_H
+#define RESERVED_MEMBERSHIPS_H
+
+#include "pg_prelude.h"
+
+/**
+ * Register the invalidation of the membership closure on role and membership
+ * changes. Must be called from _PG_init().
+ */
+extern void init_reserved_memberships(void);
+
+/**
+ * Forget the membership closure, e.g. when supautils.reserved_memberships
+ * changes. It's rebuilt on the next lookup.
+ */
+extern void invalidate_reserved_memberships(void);
+
+/**
+ * Returns the reserved role that `role` is directly or indirectly a member of,
+ * InvalidOid if there's none. Must be called inside a transaction.
+ */
+extern Oid find_reserved_membership(Oid role, const char *reserved_memberships);
+
+#endif
@@ -0,0 +1,61 @@
+#include "pg_prelude.h"
+
+#include "shmem.h"
+
+static Size total_shmem_size = 0;
+static bool shmem_reserved   = false;
+
+#if PG15_GTE
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+
+static void supautils_shmem_request(void) {
+  if (prev_shmem_request_hook) prev_shmem_request_hook();
+
+  RequestAddinShmemSpace(total_shmem_size);
+}
+#endif
+
+void request_named_shmem(Size size) {
+  if (!process_shared_preload_libraries_in_progress) return;
+
+  // ShmemInitStruct aligns every allocation to a cache line
+  total_shmem_size =
+      add_size(total_shmem_size, add_size(size, PG_CACHE_LINE_SIZE));
+}
+
+void reserve_named_shmem(void) {
+  if (!process_shared_preload_libraries_in_progress || total_shmem_size == 0)
+    return;
+
+#if PG15_GTE
+  prev_shmem_request_hook = shmem_request_hook;
+  shmem_request_hook      = supautils_shmem_request;
+#else
+  RequestAddinShmemSpace(total_shmem_size);
+#endif
+
+  shmem_reserved = true;
+}
+
+void *get_named_shmem(const char *name, Size size, void (*init)(void *ptr)) {
+  bool found = false;
+
+  if (shmem_reserved) {
+    void *ptr;
+
+    LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+    ptr = ShmemInitStruct(name, size, &found);
+    if (!found) init(ptr);
+
+    LWLockRelease(AddinShmemInitLock);
+
+    return ptr;
+  }
+
+#if PG17_GTE
+  return GetNamedDSMSegment(name, size, init, &found);
+#else
+  return NULL;
+#endif
+}
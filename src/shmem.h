@@ -0,0 +1,28 @@
+#ifndef SHMEM_H
+#define SHMEM_H
+
+#include "pg_prelude.h"
+
+/**
+ * Reserve shared memory for a named struct. Only has an effect when supautils
+ * is in shared_preload_libraries, it must be called from _PG_init() before
+ * reserve_named_shmem().
+ */
+extern void request_named_shmem(Size size);
+
+/**
+ * Reserve all the shared memory requested with request_named_shmem().
+ */
+extern void reserve_named_shmem(void);
+
+/**
+ * Get (and initialize on first use) a named shared memory struct.
+ *
+ * Uses the memory reserved at startup when supautils is preloaded, otherwise
+ * falls back to the DSM registry on pg >= 17. Returns NULL when no shared
+ * memory is available.
+ */
+extern void *get_named_shmem(const char *name, Size size,
+                             void (*init)(void *ptr));
+
+#endif
@@ -0,0 +1,191 @@
+#include "pg_prelude.h"
+
+#include "shmem.h"
+#include "stats.h"
+#include "utils.h"
+
+// On pg >= 18 the counters can be registered as custom cumulative stats so
+// they survive restarts. The kind id must be unique across the loaded modules,
+// so it's only done when the build sets one with `make PGSTAT_KIND=<id>`. The
+// stats file is written from a plain uint64 snapshot and read back into the
+// atomics, so this also requires that both share a layout.
+#if PG18_GTE && defined(SUPAUTILS_PGSTAT_KIND) && \
+    !defined(PG_HAVE_ATOMIC_U64_SIMULATION)
+#  define USE_CUSTOM_PGSTATS 1
+#else
+#  define USE_CUSTOM_PGSTATS 0
+#endif
+
+typedef struct {
+  pg_atomic_uint64 counters[STAT_COUNT];
+} stats_shared;
+
+// names for every supautils_stat, in the same order
+static const struct {
+  const char *feature;
+  const char *outcome;
+} stat_names[STAT_COUNT] = {
+  {"event_triggers", "executed"},
+  {"event_triggers", "skipped_for_superuser"},
+  {"event_triggers", "skipped_for_reserved_role"},
+  {"superuser", "escalated"},
+  {"superuser", "lock_timeout"},
+  {"extensions_parameter_overrides", "schema_overridden"},
+  {"restrict_extension_versions", "ignored"},
+  {"restrict_extension_versions", "rejected"},
+  {"constrained_extensions", "rejected"},
+  {"constrained_extensions", "concurrency_waited"},
+  {"constrained_extensions", "concurrency_wait_ms"},
+  {"constrained_extensions", "concurrency_rejected"},
+  {"extension_custom_scripts", "executed"},
+  {"hint_roles", "emitted"},
+  {"hint_roles", "not_applicable"},
+  {"reserved_roles", "rejected"},
+  {"reserved_memberships", "rejected"},
+  {"privileged_role_config_ceilings", "rejected"},
+  {"privileged_role_config_ceilings", "clamped"},
+  {"ddl_guard", "warned"},
+  {"ddl_guard", "rejected"},
+};
+
+static stats_shared *stats = NULL;
+
+// Used when there's no shared memory available (supautils is not preloaded on
+// pg < 17), the counters are per backend in that case.
+static stats_shared local_stats;
+
+// set while supautils_explain() runs the handlers, nothing is counted then
+static bool stats_paused = false;
+
+static void stats_shared_init(void *ptr) {
+  stats_shared *s = ptr;
+
+  for (int i = 0; i < STAT_COUNT; i++)
+    pg_atomic_init_u64(&s->counters[i], 0);
+}
+
+#if USE_CUSTOM_PGSTATS
+
+StaticAssertDecl(sizeof(pg_atomic_uint64) == sizeof(uint64),
+                 "the stats snapshot must have the layout of the counters");
+
+static bool pgstats_registered = false;
+
+static void stats_reset_all_cb(__attribute__((unused)) TimestampTz ts) {
+  stats_shared *s = pgstat_get_custom_shmem_data(SUPAUTILS_PGSTAT_KIND);
+
+  for (int i = 0; i < STAT_COUNT; i++)
+    pg_atomic_write_u64(&s->counters[i], 0);
+}
+
+static void stats_snapshot_cb(void) {
+  stats_shared *s = pgstat_get_custom_shmem_data(SUPAUTILS_PGSTAT_KIND);
+  uint64       *snapshot =
+      pgstat_get_custom_snapshot_data(SUPAUTILS_PGSTAT_KIND);
+
+  for (int i = 0; i < STAT_COUNT; i++)
+    snapshot[i] = pg_atomic_read_u64(&s->counters[i]);
+}
+
+static const PgStat_KindInfo stats_kind_info = {
+  .name            = "supautils",
+  .fixed_amount    = true,
+  .write_to_file   = true,
+  .shared_size     = sizeof(stats_shared),
+  .shared_data_off = 0,
+  .shared_data_len = sizeof(stats_shared),
+  .init_shmem_cb   = stats_shared_init,
+  .reset_all_cb    = stats_reset_all_cb,
+  .snapshot_cb     = stats_snapshot_cb,
+};
+
+#endif
+
+void init_stats(void) {
+#if USE_CUSTOM_PGSTATS
+  if (process_shared_preload_libraries_in_progress) {
+    pgstat_register_kind(SUPAUTILS_PGSTAT_KIND, &stats_kind_info);
+    pgstats_registered = true;
+    return;
+  }
+#endif
+
+  request_named_shmem(sizeof(stats_shared));
+}
+
+static stats_shared *get_stats(void) {
+  if (stats != NULL) return stats;
+
+#if USE_CUSTOM_PGSTATS
+  if (pgstats_registered) {
+    stats = pgstat_get_custom_shmem_data(SUPAUTILS_PGSTAT_KIND);
+    return stats;
+  }
+#endif
+
+  stats = get_named_shmem("supautils_stats", sizeof(stats_shared),
+                          stats_shared_init);
+
+  if (stats == NULL) {
+    stats_shared_init(&local_stats);
+    stats = &local_stats;
+  }
+
+  return stats;
+}
+
+void stats_incr(supautils_stat stat) {
+  if (stats_paused) return;
+
+  pg_atomic_fetch_add_u64(&get_stats()->counters[stat], 1);
+}
+
+void stats_add(supautils_stat stat, uint64 value) {
+  if (stats_paused) return;
+
+  pg_atomic_fetch_add_u64(&get_stats()->counters[stat], (int64)value);
+}
+
+void pause_stats(bool paused) { stats_paused = paused; }
+
+PG_FUNCTION_INFO_V1(supautils_stats);
+Datum supautils_stats(PG_FUNCTION_ARGS) {
+  ReturnSetInfo *rsinfo = (ReturnSetInfo *)fcinfo->resultinfo;
+  stats_shared  *s;
+
+  InitMaterializedSRF(fcinfo, 0);
+
+  s = get_stats();
+
+  for (int i = 0; i < STAT_COUNT; i++) {
+    Datum values[3];
+    bool  nulls[3] = {0};
+
+    values[0] = CStringGetTextDatum(stat_names[i].feature);
+    values[1] = CStringGetTextDatum(stat_names[i].outcome);
+    values[2] = Int64GetDatum((int64)pg_atomic_read_u64(&s->counters[i]));
+
+    tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+  }
+
+  return (Datum)0;
+}
+
+PG_FUNCTION_INFO_V1(supautils_stats_reset);
+Datum supautils_stats_reset(__attribute__((unused)) PG_FUNCTION_ARGS) {
+  stats_shared *s;
+
+#if USE_CUSTOM_PGSTATS
+  if (pgstats_registered) {
+    pgstat_reset_of_kind(SUPAUTILS_PGSTAT_KIND);
+    PG_RETURN_VOID();
+  }
+#endif
+
+  s = get_stats();
+
+  for (int i = 0; i < STAT_COUNT; i++)
+    pg_atomic_write_u64(&s->counters[i], 0);
+
+  PG_RETURN_VOID();
+}
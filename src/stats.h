@@ -0,0 +1,46 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "pg_prelude.h"
+
+typedef enum {
+  STAT_EVTRIG_EXECUTED,
+  STAT_EVTRIG_SKIPPED_SUPERUSER,
+  STAT_EVTRIG_SKIPPED_RESERVED_ROLE,
+  STAT_SUPERUSER_ESCALATED,
+  STAT_ESCALATED_LOCK_TIMEOUT,
+  STAT_EXT_SCHEMA_OVERRIDDEN,
+  STAT_EXT_VERSION_IGNORED,
+  STAT_EXT_VERSION_REJECTED,
+  STAT_EXT_CONSTRAINT_REJECTED,
+  STAT_EXT_CONCURRENCY_WAITED,
+  STAT_EXT_CONCURRENCY_WAIT_MS,
+  STAT_EXT_CONCURRENCY_REJECTED,
+  STAT_EXT_CUSTOM_SCRIPT_EXECUTED,
+  STAT_HINT_EMITTED,
+  STAT_HINT_NOT_APPLICABLE,
+  STAT_RESERVED_ROLE_REJECTED,
+  STAT_RESERVED_MEMBERSHIP_REJECTED,
+  STAT_CONFIG_CEILING_REJECTED,
+  STAT_CONFIG_CEILING_CLAMPED,
+  STAT_DDL_GUARD_WARNED,
+  STAT_DDL_GUARD_REJECTED,
+  STAT_COUNT
+} supautils_stat;
+
+/**
+ * Set up the shared memory for the counters. Must be called from _PG_init().
+ */
+extern void init_stats(void);
+
+extern void stats_incr(supautils_stat stat);
+
+extern void stats_add(supautils_stat stat, uint64 value);
+
+/**
+ * Stop or resume counting in this backend, the statements checked by
+ * supautils_explain() are not counted.
+ */
+extern void pause_stats(bool paused);
+
+#endif
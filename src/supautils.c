@@ -1,27 +1,48 @@
 #include "pg_prelude.h"
 
+#include "audit.h"
+#include "config_ceilings.h"
 #include "constrained_extensions.h"
+#include "ddl_guard.h"
 #include "drop_trigger_grants.h"
 #include "event_triggers.h"
+#include "explain.h"
+#include "extension_registry.h"
+#include "extension_slots.h"
 #include "extension_custom_scripts.h"
 #include "extensions_parameter_overrides.h"
+#include "hook_latency.h"
+#include "memory.h"
 #include "permission_hints.h"
+#include "placeholders.h"
 #include "policy_grants.h"
 #include "privileged_extensions.h"
+#include "probes.h"
+#include "process_types.h"
+#include "provision_roles.h"
+#include "reserved_memberships.h"
+#include "shmem.h"
+#include "stats.h"
 
 #define EREPORT_RESERVED_MEMBERSHIP(name)                                      \
-  ereport(ERROR,                                                               \
-          (errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),                            \
-           errmsg("\"%s\" role memberships are reserved, only superusers "     \
-                  "can grant them",                                            \
-                  name)))
+  do {                                                                         \
+    stats_incr(STAT_RESERVED_MEMBERSHIP_REJECTED);                             \
+    ereport(ERROR,                                                             \
+            (errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),                          \
+             errmsg("\"%s\" role memberships are reserved, only superusers "   \
+                    "can grant them",                                          \
+                    name)));                                                   \
+  } while (0)
 
 #define EREPORT_RESERVED_ROLE(name)                                            \
-  ereport(ERROR,                                                               \
-          (errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),                            \
-           errmsg("\"%s\" is a reserved role, only superusers can modify "     \
-                  "it",                                                        \
-                  name)))
+  do {                                                                         \
+    stats_incr(STAT_RESERVED_ROLE_REJECTED);                                   \
+    ereport(ERROR,                                                             \
+            (errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),                          \
+             errmsg("\"%s\" is a reserved role, only superusers can modify "   \
+                    "it",                                                      \
+                    name)));                                                   \
+  } while (0)
 
 #define EREPORT_INVALID_PARAMETER(name)                                        \
   ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),                    \
@@ -29,11 +50,6 @@
                          "identifiers",                                        \
                          name)));
 
-#define MAX_CONSTRAINED_EXTENSIONS 100
-#define MAX_EXTENSIONS_PARAMETER_OVERRIDES 100
-#define MAX_DROP_TRIGGER_GRANTS 100
-#define MAX_POLICY_GRANTS 100
-
 #if PG_VERSION_NUM >= 180000
 PG_MODULE_MAGIC_EXT(.name = "supautils", .version = MODVERSION);
 #else
@@ -53,14 +69,35 @@ static char *privileged_role = NULL; // the privileged_role is a proxy role for
 static char *privileged_role_allowed_configs = NULL;
 static char *hint_roles                      = NULL;
 
+static disallowed_values *compiled_disallowed_values = NULL;
+static int                placeholders_max_length    = 0;
+
+static char *executor_start_bypass_processes_str = NULL;
+static int   executor_start_bypass_processes     = 0;
+static char *fmgr_bypass_processes_str           = NULL;
+static int   fmgr_bypass_processes               = 0;
+
 static ProcessUtility_hook_type prev_hook                = NULL;
 static fmgr_hook_type           next_fmgr_hook           = NULL;
 static needs_fmgr_hook_type     next_needs_fmgr_hook     = NULL;
 static ExecutorStart_hook_type  prev_executor_start_hook = NULL;
 
-static char                 *constrained_extensions_str        = NULL;
-static constrained_extension cexts[MAX_CONSTRAINED_EXTENSIONS] = {0};
-static size_t                total_cexts                       = 0;
+static char                 *constrained_extensions_str                 = NULL;
+static constrained_extension cexts[MAX_CONSTRAINED_EXTENSIONS]          = {0};
+static size_t                total_cexts                                = 0;
+static int                   constrained_extensions_max_concurrency     = 0;
+static int                   constrained_extensions_concurrency_timeout = 0;
+
+static char          *config_ceilings_str                  = NULL;
+static config_ceiling config_ceilings[MAX_CONFIG_CEILINGS] = {0};
+static size_t         total_config_ceilings                = 0;
+
+static const struct config_enum_entry config_ceilings_mode_options[] = {
+  {"error", CONFIG_CEILINGS_ERROR, false},
+  {"clamp", CONFIG_CEILINGS_CLAMP, false},
+  {NULL, 0, false}};
+
+static int config_ceilings_mode = CONFIG_CEILINGS_ERROR;
 
 static char                         *extensions_parameter_overrides_str = NULL;
 static extension_parameter_overrides epos[MAX_EXTENSIONS_PARAMETER_OVERRIDES] =
@@ -75,8 +112,15 @@ static char               *drop_trigger_grants_str       = NULL;
 static drop_trigger_grants dtgs[MAX_DROP_TRIGGER_GRANTS] = {0};
 static size_t              total_dtgs                    = 0;
 
-static bool log_skipped_evtrigs = false;
-static bool disable_program     = false;
+static bool log_skipped_evtrigs             = false;
+static bool disable_program                 = false;
+static bool track_hook_latency              = false;
+static bool transitive_reserved_memberships = false;
+static int  escalated_lock_timeout          = 0;
+static bool audit                           = false;
+static bool extension_registry              = false;
+
+static char *audit_file = NULL;
 
 typedef enum {
   RESTRICT_EXTENSION_VERSIONS_OFF,
@@ -92,17 +136,31 @@ static const struct config_enum_entry restrict_extension_versions_options[] = {
 
 static int restrict_extension_versions = RESTRICT_EXTENSION_VERSIONS_OFF;
 
+static const struct config_enum_entry ddl_guard_options[] = {
+  {"off", DDL_GUARD_OFF, false},
+  {"warn", DDL_GUARD_WARN, false},
+  {"error", DDL_GUARD_ERROR, false},
+  {NULL, 0, false}};
+
+static int ddl_guard      = DDL_GUARD_OFF;
+static int ddl_guard_size = 0;
+
 void _PG_init(void);
 void _PG_fini(void);
 
 static bool is_reserved_role(const char *target, bool allow_configurable_roles);
 static bool is_hint_role(const char *target);
 
-static void confirm_reserved_memberships(const char *target);
+static bool is_reserved_membership(const char *target);
+
+static Oid transitive_reserved_membership(const char *target);
+
+static void confirm_reserved_memberships(stmt_context *ctx,
+                                         const char   *target);
 
 static void check_parameter(char *val, char *name);
 
-static bool is_current_role_privileged(void);
+static bool is_current_role_privileged(stmt_context *ctx);
 
 static bool is_role_privileged(const char *role);
 
@@ -110,16 +168,29 @@ static void supautils_executor_start(QueryDesc *queryDesc, int eflags);
 
 // the hook will only be attached to functions that `RETURN event_trigger`
 static bool supautils_needs_fmgr_hook(Oid functionId) {
+  hook_timer timer;
+  bool       needed;
+
   if (next_needs_fmgr_hook && (*next_needs_fmgr_hook)(functionId)) return true;
 
-  return is_event_trigger_function(functionId);
+  if (current_process_type() & fmgr_bypass_processes) return false;
+
+  hook_timer_start(&timer, track_hook_latency);
+  needed = is_event_trigger_function(functionId);
+  hook_timer_stop(&timer, HOOK_NEEDS_FMGR);
+
+  return needed;
 }
 
-static void skip_event_trigger(FmgrInfo *flinfo, const char *func_name,
+static void skip_event_trigger(supautils_stat stat, FmgrInfo *flinfo,
+                               const char *func_name, Oid current_role_oid,
                                const char *current_role_name,
                                const char *role_descriptor,
                                const char *function_condition,
                                const char *owner_name) {
+  stats_incr(stat);
+  TRACE_SUPAUTILS_EVTRIG_SKIP(current_role_oid, func_name);
+
   if (log_skipped_evtrigs) {
     ereport(NOTICE,
             errmsg("Skipping event trigger function \"%s\" for user \"%s\"",
@@ -143,7 +214,12 @@ static void supautils_fmgr_hook(FmgrHookEventType event, FmgrInfo *flinfo,
   switch (event) {
   // we only need to change behavior before the function gets executed
   case FHET_START: {
-    if (is_event_trigger_function(
+    hook_timer timer;
+
+    hook_timer_start(&timer, track_hook_latency);
+
+    if (!(current_process_type() & fmgr_bypass_processes) &&
+        is_event_trigger_function(
             flinfo->fn_oid)) { // recheck the function is an event trigger in
                                // case another extension need_fmgr_hook passed
                                // our supautils_needs_fmgr_hook
@@ -168,24 +244,33 @@ static void supautils_fmgr_hook(FmgrHookEventType event, FmgrInfo *flinfo,
       const char *function_owner_name = GetUserNameFromId(fattrs.owner, false);
       if (role_is_super) {
         if (!function_is_owned_by_super) {
-          skip_event_trigger(
-              flinfo, func_name, current_role_name, "a superuser",
-              "is not superuser-owned, it's owned by", function_owner_name);
+          skip_event_trigger(STAT_EVTRIG_SKIPPED_SUPERUSER, flinfo, func_name,
+                             current_role_oid, current_role_name, "a superuser",
+                             "is not superuser-owned, it's owned by",
+                             function_owner_name);
         } else if (!role_is_function_owner) {
-          skip_event_trigger(flinfo, func_name, current_role_name,
-                             "a superuser",
+          skip_event_trigger(STAT_EVTRIG_SKIPPED_SUPERUSER, flinfo, func_name,
+                             current_role_oid, current_role_name, "a superuser",
                              "is not owned by the same role, it's owned by",
                              function_owner_name);
+        } else {
+          stats_incr(STAT_EVTRIG_EXECUTED);
+          TRACE_SUPAUTILS_EVTRIG_EXECUTE(current_role_oid, func_name);
         }
-      } else if (role_is_reserved) {
-        if (!function_is_owned_by_super) {
-          skip_event_trigger(
-              flinfo, func_name, current_role_name, "a reserved role",
-              "is not superuser-owned, it's owned by", function_owner_name);
-        }
+      } else if (role_is_reserved && !function_is_owned_by_super) {
+        skip_event_trigger(STAT_EVTRIG_SKIPPED_RESERVED_ROLE, flinfo,
+                           func_name, current_role_oid, current_role_name,
+                           "a reserved role",
+                           "is not superuser-owned, it's owned by",
+                           function_owner_name);
+      } else {
+        stats_incr(STAT_EVTRIG_EXECUTED);
+        TRACE_SUPAUTILS_EVTRIG_EXECUTE(current_role_oid, func_name);
       }
     }
 
+    hook_timer_stop(&timer, HOOK_FMGR);
+
     if (next_fmgr_hook) (*next_fmgr_hook)(event, flinfo, private);
     break;
   }
@@ -202,8 +287,19 @@ static void supautils_fmgr_hook(FmgrHookEventType event, FmgrInfo *flinfo,
 
 static void supautils_executor_start(QueryDesc *queryDesc, int eflags) {
   MemoryContext cur_ctx = CurrentMemoryContext;
+  hook_timer    timer;
+  bool          role_is_hint;
+
+  // hints are only useful to client backends
+  if (current_process_type() & executor_start_bypass_processes)
+    role_is_hint = false;
+  else {
+    hook_timer_start(&timer, track_hook_latency);
+    role_is_hint = is_hint_role(GetUserNameFromId(GetUserId(), false));
+    hook_timer_stop(&timer, HOOK_EXECUTOR_START);
+  }
 
-  if (!is_hint_role(GetUserNameFromId(GetUserId(), false))) {
+  if (!role_is_hint) {
     if (prev_executor_start_hook)
       prev_executor_start_hook(queryDesc, eflags);
     else
@@ -218,45 +314,35 @@ static void supautils_executor_start(QueryDesc *queryDesc, int eflags) {
     }
     PG_CATCH();
     {
-      MemoryContext oldcxt = MemoryContextSwitchTo(cur_ctx);
-      ErrorData    *edata  = CopyErrorData();
+      hook_timer    hint_timer;
+      MemoryContext oldcxt;
+      ErrorData    *edata;
+
+      hook_timer_start(&hint_timer, track_hook_latency);
+
+      oldcxt = MemoryContextSwitchTo(cur_ctx);
+      edata  = CopyErrorData();
       MemoryContextSwitchTo(oldcxt);
 
       FlushErrorState();
 
       if (edata->sqlerrcode == ERRCODE_INSUFFICIENT_PRIVILEGE) {
         const Oid current_role_oid = GetUserId();
+        Oid       relid;
+        char     *hint;
 
-        missing_perm missing =
-            find_missing_perm(queryDesc->plannedstmt, current_role_oid);
-
-        if (missing.acl != 0 && OidIsValid(missing.relid) &&
-            (missing.acl & (ACL_TRUNCATE | ACL_TRIGGER | ACL_REFERENCES)) ==
-                0) {
-
-          StringInfo privileges_str = makeStringInfo();
-          build_privileges_string(privileges_str, missing.acl);
-
-          if (privileges_str->len > 0) {
-            char *schema = get_namespace_name(get_rel_namespace(missing.relid));
-            char *relname = get_rel_name(missing.relid);
-
-            if (relname != NULL) {
-              char *qualified_rel_name =
-                  quote_qualified_identifier(schema, relname);
-              char *username = GetUserNameFromId(current_role_oid, false);
-              char *quoted_role_name =
-                  quote_qualified_identifier(NULL, username);
-
-              edata->hint = psprintf(
-                  "Grant the required privileges to the current "
-                  "role with: GRANT %s ON %s TO %s;",
-                  privileges_str->data, qualified_rel_name, quoted_role_name);
-            }
-          }
-        }
+        TRACE_SUPAUTILS_HINT_START(current_role_oid);
+
+        hint = find_permission_hint(queryDesc->plannedstmt, current_role_oid,
+                                    &relid);
+        if (hint != NULL) edata->hint = hint;
+
+        stats_incr(hint != NULL ? STAT_HINT_EMITTED : STAT_HINT_NOT_APPLICABLE);
+        TRACE_SUPAUTILS_HINT_DONE(current_role_oid, relid, hint != NULL);
       }
 
+      hook_timer_stop(&hint_timer, HOOK_EXECUTOR_START_HINT);
+
       ReThrowError(edata);
     }
     PG_END_TRY();
@@ -264,19 +350,21 @@ static void supautils_executor_start(QueryDesc *queryDesc, int eflags) {
 }
 
 static List *restrict_version_specification(extension_stmt_kind stmt_kind,
+                                            const char         *extname,
                                             List               *options,
+                                            stmt_context       *ctx,
                                             const char *supautils_superuser) {
-  ListCell *lc;
+  ListCell      *lc;
+  extension_info info;
 
   if (restrict_extension_versions == RESTRICT_EXTENSION_VERSIONS_OFF)
     return options;
 
-  if (superuser()) return options;
+  if (stmt_role_is_superuser(ctx)) return options;
 
-  if (supautils_superuser != NULL && supautils_superuser[0] != '\0') {
-    const char *current_user = GetUserNameFromId(GetUserId(), false);
-    if (strcmp(current_user, supautils_superuser) == 0) return options;
-  }
+  if (supautils_superuser != NULL && supautils_superuser[0] != '\0' &&
+      strcmp(stmt_role_name(ctx), supautils_superuser) == 0)
+    return options;
 
   foreach (lc, options) {
     DefElem *defel = (DefElem *)lfirst(lc);
@@ -284,6 +372,8 @@ static List *restrict_version_specification(extension_stmt_kind stmt_kind,
     if (strcmp(defel->defname, "new_version") != 0) continue;
 
     if (restrict_extension_versions == RESTRICT_EXTENSION_VERSIONS_ERROR) {
+      stats_incr(STAT_EXT_VERSION_REJECTED);
+
       if (stmt_kind == EXT_CREATE)
         ereport(ERROR,
                 (errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
@@ -298,18 +388,32 @@ static List *restrict_version_specification(extension_stmt_kind stmt_kind,
     }
 
     // warn mode: drop the version option so the default version is used
+    stats_incr(STAT_EXT_VERSION_IGNORED);
+
+    // the default version is only named when the registry knows it
+    if (lookup_extension(extname, &info) != REGISTRY_FOUND)
+      info.default_version[0] = '\0';
+
     if (stmt_kind == EXT_CREATE)
       ereport(WARNING,
               (errmsg("only superusers can specify extension versions, "
                       "ignoring version \"%s\" and installing the default "
                       "version",
-                      strVal(defel->arg))));
+                      strVal(defel->arg)),
+               info.default_version[0] != '\0'
+                   ? errdetail("The default version of \"%s\" is %s.",
+                               extname, info.default_version)
+                   : 0));
     else
       ereport(WARNING,
               (errmsg("only superusers can specify extension versions, "
                       "ignoring version \"%s\" and updating to the default "
                       "version",
-                      strVal(defel->arg))));
+                      strVal(defel->arg)),
+               info.default_version[0] != '\0'
+                   ? errdetail("The default version of \"%s\" is %s.",
+                               extname, info.default_version)
+                   : 0));
 
     options = foreach_delete_current(options, lc);
   }
@@ -317,809 +421,1093 @@ static List *restrict_version_specification(extension_stmt_kind stmt_kind,
   return options;
 }
 
-static void supautils_hook(PROCESS_UTILITY_PARAMS) {
-  /* Get the utility statement from the planned statement */
-  Node *utility_stmt = pstmt->utilityStmt;
+// The checks below are recorded on an explained statement, see explain.h
 
-  switch (utility_stmt->type) {
-  /*
-   * ALTER ROLE <role> NOLOGIN NOINHERIT..
-   */
-  case T_AlterRoleStmt: {
-    AlterRoleStmt *stmt        = (AlterRoleStmt *)utility_stmt;
-    ListCell      *option_cell = NULL;
-    bool           already_switched_to_superuser = false;
+static void confirm_reserved_role(stmt_context *ctx, const char *role_name,
+                                  bool allow_configurable_roles) {
+  bool reserved = is_reserved_role(role_name, allow_configurable_roles);
 
-    if (!IsTransactionState()) {
-      break;
-    }
-    if (superuser()) {
-      break;
-    }
+  trace_check(ctx, "reserved_role", role_name, trace_bool(reserved));
 
-    char *role_name = get_rolespec_name(stmt->role);
+  if (reserved) EREPORT_RESERVED_ROLE(role_name);
+}
 
-    if (is_reserved_role(role_name, false)) EREPORT_RESERVED_ROLE(role_name);
+static bool check_allowed_config(stmt_context *ctx, const char *name) {
+  bool allowed = privileged_role_allowed_configs != NULL &&
+                 is_string_in_comma_delimited_string(
+                     name, privileged_role_allowed_configs);
 
-    if (!is_current_role_privileged()) {
-      break;
-    }
+  trace_check(ctx, "privileged_role_allowed_config", name, trace_bool(allowed));
 
-    if (is_role_privileged(role_name)) {
-      ereport(ERROR,
-              (errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
-               errmsg("permission denied to alter role"),
-               errdetail("Only superusers can alter privileged roles.")));
-    }
+  return allowed;
+}
 
-    // Setting the superuser attribute is not allowed.
-    foreach (option_cell, stmt->options) {
-      DefElem *defel = lfirst_node(DefElem, option_cell);
-      if (strcmp(defel->defname, "superuser") == 0) {
-        ereport(ERROR, (errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
-                        errmsg("permission denied to alter role"),
-                        errdetail("Only roles with the %s attribute may alter "
-                                  "roles with the %s attribute.",
-                                  "SUPERUSER", "SUPERUSER")));
-      }
-    }
+static bool check_privileged_extension(stmt_context *ctx, const char *extname) {
+  bool privileged = is_extension_privileged(extname, privileged_extensions);
 
-    // Allow setting bypassrls & replication.
-    switch_to_superuser(supautils_superuser, &already_switched_to_superuser);
+  trace_check(ctx, "privileged_extension", extname, trace_bool(privileged));
 
-    run_process_utility_hook_with_cleanup(
-        prev_hook, already_switched_to_superuser, switch_to_original_role);
+  return privileged;
+}
 
-    if (!already_switched_to_superuser) {
-      switch_to_original_role();
-    }
+// The table of a DROP or COMMENT ON for a POLICY or TRIGGER. The last name is
+// the object itself, the rest is the table name.
+static RangeVar *object_table(List *object) {
+  return makeRangeVarFromNameList(
+      list_truncate(list_copy(object), list_length(object) - 1));
+}
 
-    return;
+// The grants of an explained statement are resolved without locking the table.
+static bool check_policy_grant(stmt_context *ctx, RangeVar *table) {
+  bool granted = is_current_role_granted_table_policy(
+      table, ctx, pgs, total_pgs,
+      stmt_is_explained(ctx) ? NoLock : AccessExclusiveLock);
+
+  trace_check(ctx, "policy_grant", table->relname, trace_bool(granted));
+
+  return granted;
+}
+
+static bool check_drop_trigger_grant(stmt_context *ctx, RangeVar *table) {
+  bool granted = is_current_role_granted_table_drop_trigger(
+      table, ctx, dtgs, total_dtgs,
+      stmt_is_explained(ctx) ? NoLock : AccessExclusiveLock);
+
+  trace_check(ctx, "drop_trigger_grant", table->relname, trace_bool(granted));
+
+  return granted;
+}
+
+#define UTILITY_HANDLER_PARAMS                                                 \
+  PROCESS_UTILITY_PARAMS, stmt_context *ctx, hook_timer *utility_timer
+
+// A handler returns true when it already ran the statement, otherwise the
+// statement is chained to the previous hooks as usual.
+typedef bool (*utility_handler)(UTILITY_HANDLER_PARAMS);
+
+// the handlers share a signature, not all of them use every parameter
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+
+// Run the statement as supautils.superuser
+static void run_as_superuser(UTILITY_HANDLER_PARAMS) {
+  bool already_switched_to_superuser = false;
+
+  if (trace_decision(ctx, "escalate")) return;
+
+  switch_to_superuser(supautils_superuser, &already_switched_to_superuser);
+
+  run_process_utility_hook_with_cleanup(
+      prev_hook, already_switched_to_superuser, switch_to_original_role);
+
+  if (!already_switched_to_superuser) {
+    switch_to_original_role();
   }
+}
 
-  /*
-   * ALTER ROLE <role> SET search_path TO ...
-   */
-  case T_AlterRoleSetStmt: {
-    AlterRoleSetStmt *stmt               = (AlterRoleSetStmt *)utility_stmt;
-    bool              role_is_privileged = false;
+// Run the statement as the current role, for a handler that must do something
+// after it
+static void run_chained(UTILITY_HANDLER_PARAMS) {
+  if (trace_decision(ctx, "chain")) return;
 
-    if (!IsTransactionState()) {
-      break;
-    }
-    if (superuser()) {
-      break;
-    }
+  run_process_utility_hook(prev_hook);
+}
+
+/*
+ * ALTER ROLE <role> NOLOGIN NOINHERIT..
+ */
+static bool handle_alter_role(UTILITY_HANDLER_PARAMS) {
+  AlterRoleStmt *stmt        = (AlterRoleStmt *)pstmt->utilityStmt;
+  ListCell      *option_cell = NULL;
+
+  if (!IsTransactionState()) {
+    return false;
+  }
+  if (stmt_role_is_superuser(ctx)) {
+    return false;
+  }
 
-    role_is_privileged = is_current_role_privileged();
+  char *role_name = get_rolespec_name(stmt->role);
 
-    char *role_name = get_rolespec_name(stmt->role);
+  confirm_reserved_role(ctx, role_name, false);
 
-    if (is_reserved_role(role_name, role_is_privileged))
-      EREPORT_RESERVED_ROLE(role_name);
+  if (!is_current_role_privileged(ctx)) {
+    return false;
+  }
 
-    if (!role_is_privileged) {
-      break;
-    }
+  if (is_role_privileged(role_name)) {
+    ereport(ERROR,
+            (errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+             errmsg("permission denied to alter role"),
+             errdetail("Only superusers can alter privileged roles.")));
+  }
 
-    if (privileged_role_allowed_configs == NULL) {
-      break;
-    } else {
-      bool is_privileged_role_allowed_config =
-          is_string_in_comma_delimited_string(
-              ((VariableSetStmt *)stmt->setstmt)->name,
-              privileged_role_allowed_configs);
-
-      if (!is_privileged_role_allowed_config) {
-        break;
-      }
+  // Setting the superuser attribute is not allowed.
+  foreach (option_cell, stmt->options) {
+    DefElem *defel = lfirst_node(DefElem, option_cell);
+    if (strcmp(defel->defname, "superuser") == 0) {
+      ereport(ERROR, (errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+                      errmsg("permission denied to alter role"),
+                      errdetail("Only roles with the %s attribute may alter "
+                                "roles with the %s attribute.",
+                                "SUPERUSER", "SUPERUSER")));
     }
+  }
 
-    {
-      bool already_switched_to_superuser = false;
-      switch_to_superuser(supautils_superuser, &already_switched_to_superuser);
+  // Allow setting bypassrls & replication.
+  run_as_superuser(PROCESS_UTILITY_ARGS, ctx, utility_timer);
 
-      run_process_utility_hook_with_cleanup(
-          prev_hook, already_switched_to_superuser, switch_to_original_role);
+  return true;
+}
 
-      if (!already_switched_to_superuser) {
-        switch_to_original_role();
-      }
+/*
+ * ALTER ROLE <role> SET search_path TO ...
+ */
+static bool handle_alter_role_set(UTILITY_HANDLER_PARAMS) {
+  AlterRoleSetStmt *stmt               = (AlterRoleSetStmt *)pstmt->utilityStmt;
+  bool              role_is_privileged = false;
+  List             *clamped;
 
-      return;
-    }
+  if (!IsTransactionState()) {
+    return false;
+  }
+  if (stmt_role_is_superuser(ctx)) {
+    return false;
+  }
 
-    return;
+  role_is_privileged = is_current_role_privileged(ctx);
+
+  char *role_name = get_rolespec_name(stmt->role);
+
+  confirm_reserved_role(ctx, role_name, role_is_privileged);
+
+  if (!role_is_privileged) {
+    return false;
   }
 
-  /*
-   * CREATE ROLE
-   */
-  case T_CreateRoleStmt: {
-    if (IsTransactionState() && !superuser()) {
-      CreateRoleStmt *stmt         = (CreateRoleStmt *)utility_stmt;
-      const char     *created_role = stmt->role;
-      List           *addroleto    = NIL; /* roles to make this a member of */
-      bool hasrolemembers = false; /* has roles to be members of this role */
-      ListCell *option_cell;
-
-      /* if role already exists, bypass the hook to let it fail with the usual
-       * error */
-      if (OidIsValid(get_role_oid(created_role, true))) break;
-
-      /* CREATE ROLE <reserved_role> */
-      if (is_reserved_role(created_role, false))
-        EREPORT_RESERVED_ROLE(created_role);
-
-      /* Check to see if there are any descriptions related to membership. */
-      foreach (option_cell, stmt->options) {
-        DefElem *defel = lfirst_node(DefElem, option_cell);
-        if (strcmp(defel->defname, "addroleto") == 0)
-          addroleto = (List *)defel->arg;
-
-        if (strcmp(defel->defname, "rolemembers") == 0 ||
-            strcmp(defel->defname, "adminmembers") == 0)
-          hasrolemembers = true;
-
-        // Setting the superuser attribute is not allowed.
-        if (strcmp(defel->defname, "superuser") == 0 && defGetBoolean(defel)) {
-          ereport(ERROR, (errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
-                          errmsg("permission denied to create role"),
-                          errdetail("Only roles with the %s attribute may "
-                                    "create roles with the %s attribute.",
-                                    "SUPERUSER", "SUPERUSER")));
-        }
-      }
+  if (!check_allowed_config(ctx, stmt->setstmt->name)) {
+    return false;
+  }
 
-      /* CREATE ROLE <any_role> IN ROLE/GROUP <role_with_reserved_membership> */
-      if (addroleto) {
-        ListCell *role_cell;
-        foreach (role_cell, addroleto) {
-          RoleSpec *rolemember = lfirst_node(RoleSpec, role_cell);
-          confirm_reserved_memberships(get_rolespec_name(rolemember));
-        }
-      }
+  clamped = apply_config_ceiling(stmt->setstmt, config_ceilings,
+                                 total_config_ceilings, config_ceilings_mode);
+  trace_check(ctx, "config_ceiling", stmt->setstmt->name,
+              clamped != NIL ? "clamped" : "none");
 
-      /*
-       * CREATE ROLE <role_with_reserved_membership> ROLE/ADMIN/USER <any_role>
-       *
-       * This is a contrived case because the "role_with_reserved_membership"
-       * should already exist, but handle it anyway.
-       */
-      if (hasrolemembers) confirm_reserved_memberships(created_role);
-
-      // We don't want to switch to superuser on PG16+ because the
-      // creating role is implicitly granted ADMIN on the new
-      // role:
-      // https://www.postgresql.org/docs/16/runtime-config-client.html#GUC-CREATEROLE-SELF-GRANT
-      //
-      // This ADMIN will be missing if we switch to superuser
-      // since the creating role becomes the superuser.
-      //
-      // We also no longer need superuser to grant BYPASSRLS &
-      // REPLICATION anyway.
-#if PG16_GTE
-      run_process_utility_hook(prev_hook);
-#else
-      if (is_current_role_privileged()) {
-        bool already_switched_to_superuser = false;
+  // the statement may be cached, e.g. in a plpgsql function, so the clamped
+  // value is set on a copy
+  if (clamped != NIL) {
+    pstmt = copyObject(pstmt);
+    ((AlterRoleSetStmt *)pstmt->utilityStmt)->setstmt->args = clamped;
+  }
 
-        // Allow `privileged_role` (in addition to superusers) to
-        // set bypassrls & replication attributes.
-        switch_to_superuser(supautils_superuser,
-                            &already_switched_to_superuser);
+  run_as_superuser(PROCESS_UTILITY_ARGS, ctx, utility_timer);
 
-        run_process_utility_hook_with_cleanup(
-            prev_hook, already_switched_to_superuser, switch_to_original_role);
+  return true;
+}
 
-        if (!already_switched_to_superuser) {
-          switch_to_original_role();
-        }
-      } else {
-        run_process_utility_hook(prev_hook);
-      }
-#endif
+/*
+ * CREATE ROLE
+ */
+static bool handle_create_role(UTILITY_HANDLER_PARAMS) {
+  CreateRoleStmt *stmt         = (CreateRoleStmt *)pstmt->utilityStmt;
+  const char     *created_role = stmt->role;
+  /* roles to make this a member of */
+  List *addroleto = NIL;
+  /* has roles to be members of this role */
+  bool      hasrolemembers = false;
+  ListCell *option_cell;
+
+  if (!IsTransactionState() || stmt_role_is_superuser(ctx)) {
+    return false;
+  }
+
+  /* if role already exists, bypass the hook to let it fail with the usual
+   * error */
+  if (OidIsValid(get_role_oid(created_role, true))) return false;
+
+  /* CREATE ROLE <reserved_role> */
+  confirm_reserved_role(ctx, created_role, false);
 
-      return;
+  /* Check to see if there are any descriptions related to membership. */
+  foreach (option_cell, stmt->options) {
+    DefElem *defel = lfirst_node(DefElem, option_cell);
+    if (strcmp(defel->defname, "addroleto") == 0)
+      addroleto = (List *)defel->arg;
+
+    if (strcmp(defel->defname, "rolemembers") == 0 ||
+        strcmp(defel->defname, "adminmembers") == 0)
+      hasrolemembers = true;
+
+    // Setting the superuser attribute is not allowed.
+    if (strcmp(defel->defname, "superuser") == 0 && defGetBoolean(defel)) {
+      ereport(ERROR, (errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+                      errmsg("permission denied to create role"),
+                      errdetail("Only roles with the %s attribute may "
+                                "create roles with the %s attribute.",
+                                "SUPERUSER", "SUPERUSER")));
     }
-    break;
   }
 
-  /*
-   * DROP ROLE
-   */
-  case T_DropRoleStmt: {
-    if (IsTransactionState() && !superuser()) {
-      DropRoleStmt *stmt = (DropRoleStmt *)utility_stmt;
-      ListCell     *item;
-
-      foreach (item, stmt->roles) {
-        RoleSpec *role = lfirst_node(RoleSpec, item);
-
-        /*
-         * We check only for a named role being dropped; we ignore
-         * the special values like PUBLIC, CURRENT_USER, and
-         * SESSION_USER. We let Postgres throw its usual error messages
-         * for those special values.
-         */
-        if (role->roletype != ROLESPEC_CSTRING) break;
-
-        if (is_reserved_role(role->rolename, false))
-          EREPORT_RESERVED_ROLE(role->rolename);
-      }
+  /* CREATE ROLE <any_role> IN ROLE/GROUP <role_with_reserved_membership> */
+  if (addroleto) {
+    ListCell *role_cell;
+    foreach (role_cell, addroleto) {
+      RoleSpec *rolemember = lfirst_node(RoleSpec, role_cell);
+      confirm_reserved_memberships(ctx, get_rolespec_name(rolemember));
     }
-    break;
   }
 
   /*
-   * GRANT <role> and REVOKE <role>
+   * CREATE ROLE <role_with_reserved_membership> ROLE/ADMIN/USER <any_role>
+   *
+   * This is a contrived case because the "role_with_reserved_membership"
+   * should already exist, but handle it anyway.
    */
-  case T_GrantRoleStmt: {
-    if (IsTransactionState() && !superuser()) {
-      GrantRoleStmt *stmt = (GrantRoleStmt *)utility_stmt;
-      ListCell      *grantee_role_cell;
-      ListCell      *role_cell;
-      bool           role_is_privileged = false;
-
-      /* GRANT <reserved_role> TO <role> */
-      if (stmt->is_grant) {
-        foreach (role_cell, stmt->granted_roles) {
-          AccessPriv *priv = lfirst_node(AccessPriv, role_cell);
-          confirm_reserved_memberships(priv->priv_name);
-        }
-      }
+  if (hasrolemembers) confirm_reserved_memberships(ctx, created_role);
+
+  // We don't want to switch to superuser on PG16+ because the
+  // creating role is implicitly granted ADMIN on the new
+  // role:
+  // https://www.postgresql.org/docs/16/runtime-config-client.html#GUC-CREATEROLE-SELF-GRANT
+  //
+  // This ADMIN will be missing if we switch to superuser
+  // since the creating role becomes the superuser.
+  //
+  // We also no longer need superuser to grant BYPASSRLS &
+  // REPLICATION anyway.
+#if PG16_GTE
+  run_chained(PROCESS_UTILITY_ARGS, ctx, utility_timer);
+#else
+  if (is_current_role_privileged(ctx)) {
+    // Allow `privileged_role` (in addition to superusers) to
+    // set bypassrls & replication attributes.
+    run_as_superuser(PROCESS_UTILITY_ARGS, ctx, utility_timer);
+  } else {
+    run_chained(PROCESS_UTILITY_ARGS, ctx, utility_timer);
+  }
+#endif
 
-      role_is_privileged = is_current_role_privileged();
-
-      /*
-       * GRANT <role> TO <reserved_roles>
-       * REVOKE <role> FROM <reserved_roles>
-       */
-      foreach (grantee_role_cell, stmt->grantee_roles) {
-        RoleSpec *spec      = lfirst_node(RoleSpec, grantee_role_cell);
-        char     *role_name = get_rolespec_name(spec);
-        // privileged_role can do GRANT <role> to <reserved_role>
-        if (is_reserved_role(role_name, role_is_privileged))
-          EREPORT_RESERVED_ROLE(role_name);
-      }
-    }
-    break;
+  return true;
+}
+
+/*
+ * DROP ROLE
+ */
+static bool handle_drop_role(UTILITY_HANDLER_PARAMS) {
+  DropRoleStmt *stmt = (DropRoleStmt *)pstmt->utilityStmt;
+  ListCell     *item;
+
+  if (!IsTransactionState() || stmt_role_is_superuser(ctx)) {
+    return false;
   }
 
-  /*
-   * All RENAME statements are caught here
-   */
-  case T_RenameStmt: {
-    if (IsTransactionState() && !superuser()) {
-      RenameStmt *stmt = (RenameStmt *)utility_stmt;
+  foreach (item, stmt->roles) {
+    RoleSpec *role = lfirst_node(RoleSpec, item);
 
-      /* Make sure we only catch "ALTER ROLE <role> RENAME TO" */
-      if (stmt->renameType != OBJECT_ROLE) break;
+    /*
+     * We check only for a named role being dropped; we ignore
+     * the special values like PUBLIC, CURRENT_USER, and
+     * SESSION_USER. We let Postgres throw its usual error messages
+     * for those special values.
+     */
+    if (role->roletype != ROLESPEC_CSTRING) break;
 
-      if (is_reserved_role(stmt->subname, false))
-        EREPORT_RESERVED_ROLE(stmt->subname);
+    confirm_reserved_role(ctx, role->rolename, false);
+  }
 
-      if (is_reserved_role(stmt->newname, false))
-        EREPORT_RESERVED_ROLE(stmt->newname);
+  return false;
+}
+
+/*
+ * GRANT <role> and REVOKE <role>
+ */
+static bool handle_grant_role(UTILITY_HANDLER_PARAMS) {
+  GrantRoleStmt *stmt = (GrantRoleStmt *)pstmt->utilityStmt;
+  ListCell      *grantee_role_cell;
+  ListCell      *role_cell;
+  bool           role_is_privileged = false;
+
+  if (!IsTransactionState() || stmt_role_is_superuser(ctx)) {
+    return false;
+  }
+
+  /* GRANT <reserved_role> TO <role> */
+  if (stmt->is_grant) {
+    foreach (role_cell, stmt->granted_roles) {
+      AccessPriv *priv = lfirst_node(AccessPriv, role_cell);
+      confirm_reserved_memberships(ctx, priv->priv_name);
     }
-    break;
   }
 
+  role_is_privileged = is_current_role_privileged(ctx);
+
   /*
-   * CREATE EXTENSION <extension>
+   * GRANT <role> TO <reserved_roles>
+   * REVOKE <role> FROM <reserved_roles>
    */
-  case T_CreateExtensionStmt: {
-    CreateExtensionStmt *volatile stmt = (CreateExtensionStmt *)utility_stmt;
+  foreach (grantee_role_cell, stmt->grantee_roles) {
+    RoleSpec *spec      = lfirst_node(RoleSpec, grantee_role_cell);
+    char     *role_name = get_rolespec_name(spec);
+    // privileged_role can do GRANT <role> to <reserved_role>
+    confirm_reserved_role(ctx, role_name, role_is_privileged);
+  }
 
-    stmt->options = restrict_version_specification(EXT_CREATE, stmt->options,
-                                                   supautils_superuser);
+  return false;
+}
 
-    constrain_extension(stmt->extname, cexts, total_cexts);
+/*
+ * All RENAME statements are caught here
+ */
+static bool handle_rename(UTILITY_HANDLER_PARAMS) {
+  RenameStmt *stmt = (RenameStmt *)pstmt->utilityStmt;
 
-    bool already_switched_to_superuser = false;
+  if (!IsTransactionState() || stmt_role_is_superuser(ctx)) {
+    return false;
+  }
 
-    switch_to_superuser(supautils_superuser, &already_switched_to_superuser);
+  /* Make sure we only catch "ALTER ROLE <role> RENAME TO" */
+  if (stmt->renameType != OBJECT_ROLE) return false;
 
-    run_global_before_create_script(stmt->extname, stmt->options,
-                                    extension_custom_scripts_path);
+  confirm_reserved_role(ctx, stmt->subname, false);
+  confirm_reserved_role(ctx, stmt->newname, false);
 
-    run_ext_before_create_script(stmt->extname, stmt->options,
-                                 extension_custom_scripts_path);
+  return false;
+}
 
-    stmt->options = override_ext_options(EXT_CREATE, stmt->extname,
-                                         stmt->options, total_epos, epos);
+// Take a concurrency slot for DDL on a constrained extension, returns whether
+// one was taken. An explained statement only reports whether one is free.
+static bool acquire_constrained_extension_slot(stmt_context *ctx,
+                                               const char   *name) {
+  constrained_extension *cext =
+      find_constrained_extension(name, cexts, total_cexts);
 
-    if (is_extension_privileged(stmt->extname, privileged_extensions)) {
-      run_process_utility_hook_with_cleanup(
-          prev_hook, already_switched_to_superuser, switch_to_original_role);
-    } else {
-      if (!already_switched_to_superuser) {
-        switch_to_original_role();
-      }
+  if (cext == NULL) return false;
 
-      run_process_utility_hook(prev_hook);
+  if (stmt_is_explained(ctx)) {
+    trace_check(ctx, "extension_slot", name,
+                peek_extension_slot(name, cext->concurrency,
+                                    constrained_extensions_max_concurrency));
+    return false;
+  }
 
-      switch_to_superuser(supautils_superuser, &already_switched_to_superuser);
-    }
+  return acquire_extension_slot(name, cext->concurrency,
+                                constrained_extensions_max_concurrency,
+                                constrained_extensions_concurrency_timeout);
+}
+
+static void create_extension(UTILITY_HANDLER_PARAMS) {
+  CreateExtensionStmt *volatile stmt =
+      (CreateExtensionStmt *)pstmt->utilityStmt;
+
+  bool already_switched_to_superuser = false;
+  bool privileged;
+
+  // the custom scripts of an explained statement are only looked up
+  if (!stmt_is_explained(ctx))
+    switch_to_superuser(supautils_superuser, &already_switched_to_superuser);
+
+  run_global_before_create_script(stmt->extname, stmt->options,
+                                  extension_custom_scripts_path, ctx);
+
+  run_ext_before_create_script(stmt->extname, stmt->options,
+                               extension_custom_scripts_path, ctx);
 
+  stmt->options = override_ext_options(EXT_CREATE, stmt->extname,
+                                       stmt->options, total_epos, epos);
+
+  privileged = check_privileged_extension(ctx, stmt->extname);
+
+  if (trace_decision(ctx, privileged ? "escalate" : "chain")) {
     run_ext_after_create_script(stmt->extname, stmt->options,
-                                extension_custom_scripts_path);
+                                extension_custom_scripts_path, ctx);
+    return;
+  }
 
+  if (privileged) {
+    run_process_utility_hook_with_cleanup(
+        prev_hook, already_switched_to_superuser, switch_to_original_role);
+  } else {
     if (!already_switched_to_superuser) {
       switch_to_original_role();
     }
 
-    return;
+    run_process_utility_hook(prev_hook);
+
+    switch_to_superuser(supautils_superuser, &already_switched_to_superuser);
   }
 
-  /*
-   * ALTER EXTENSION <extension> [ ADD | DROP | UPDATE ]
-   */
-  case T_AlterExtensionStmt: {
-    if (superuser()) {
-      break;
-    }
+  run_ext_after_create_script(stmt->extname, stmt->options,
+                              extension_custom_scripts_path, ctx);
 
-    AlterExtensionStmt *stmt = (AlterExtensionStmt *)pstmt->utilityStmt;
+  if (!already_switched_to_superuser) {
+    switch_to_original_role();
+  }
+}
 
-    stmt->options = restrict_version_specification(EXT_ALTER, stmt->options,
-                                                   supautils_superuser);
+/*
+ * CREATE EXTENSION <extension>
+ */
+static bool handle_create_extension(UTILITY_HANDLER_PARAMS) {
+  CreateExtensionStmt *stmt = (CreateExtensionStmt *)pstmt->utilityStmt;
+  volatile bool        holds_slot;
 
-    stmt->options = override_ext_options(EXT_ALTER, stmt->extname,
-                                         stmt->options, total_epos, epos);
+  stmt->options =
+      restrict_version_specification(EXT_CREATE, stmt->extname, stmt->options,
+                                     ctx, supautils_superuser);
 
-    if (is_extension_privileged(stmt->extname, privileged_extensions)) {
-      bool already_switched_to_superuser = false;
+  constrain_extension(stmt->extname, cexts, total_cexts);
 
-      switch_to_superuser(supautils_superuser, &already_switched_to_superuser);
+  if (stmt_is_explained(ctx))
+    trace_check(ctx, "constrained_extension", stmt->extname,
+                find_constrained_extension(stmt->extname, cexts, total_cexts)
+                    ? "satisfied"
+                    : "none");
 
-      run_process_utility_hook_with_cleanup(
-          prev_hook, already_switched_to_superuser, switch_to_original_role);
+  // held for the custom scripts too, they can be as heavy as the extension
+  holds_slot = acquire_constrained_extension_slot(ctx, stmt->extname);
 
-      if (!already_switched_to_superuser) {
-        switch_to_original_role();
-      }
-    }
+  PG_TRY();
+  {
+    create_extension(PROCESS_UTILITY_ARGS, ctx, utility_timer);
+  }
+  PG_CATCH();
+  {
+    if (holds_slot) release_extension_slot();
+    PG_RE_THROW();
+  }
+  PG_END_TRY();
 
-    break;
+  if (holds_slot) release_extension_slot();
+
+  return true;
+}
+
+/*
+ * ALTER EXTENSION <extension> [ ADD | DROP | UPDATE ]
+ */
+static bool handle_alter_extension(UTILITY_HANDLER_PARAMS) {
+  AlterExtensionStmt *stmt = (AlterExtensionStmt *)pstmt->utilityStmt;
+  volatile bool       holds_slot;
+
+  if (stmt_role_is_superuser(ctx)) {
+    return false;
   }
 
-  /*
-   * ALTER EXTENSION <extension> SET SCHEMA
-   */
-  case T_AlterObjectSchemaStmt: {
-    if (superuser()) {
-      break;
+  stmt->options =
+      restrict_version_specification(EXT_ALTER, stmt->extname, stmt->options,
+                                     ctx, supautils_superuser);
+
+  stmt->options = override_ext_options(EXT_ALTER, stmt->extname,
+                                       stmt->options, total_epos, epos);
+
+  holds_slot = acquire_constrained_extension_slot(ctx, stmt->extname);
+
+  PG_TRY();
+  {
+    if (check_privileged_extension(ctx, stmt->extname)) {
+      run_as_superuser(PROCESS_UTILITY_ARGS, ctx, utility_timer);
     }
 
-    AlterObjectSchemaStmt *stmt = (AlterObjectSchemaStmt *)pstmt->utilityStmt;
+    // the statement is chained here so it runs while holding the slot
+    if (holds_slot) {
+      run_chained(PROCESS_UTILITY_ARGS, ctx, utility_timer);
+    }
+  }
+  PG_CATCH();
+  {
+    if (holds_slot) release_extension_slot();
+    PG_RE_THROW();
+  }
+  PG_END_TRY();
 
-    if (stmt->objectType == OBJECT_EXTENSION &&
-        is_extension_privileged(strVal(stmt->object), privileged_extensions)) {
-      bool already_switched_to_superuser = false;
+  if (holds_slot) release_extension_slot();
 
-      switch_to_superuser(supautils_superuser, &already_switched_to_superuser);
+  return holds_slot;
+}
 
-      run_process_utility_hook_with_cleanup(
-          prev_hook, already_switched_to_superuser, switch_to_original_role);
+/*
+ * ALTER EXTENSION <extension> SET SCHEMA
+ */
+static bool handle_alter_object_schema(UTILITY_HANDLER_PARAMS) {
+  AlterObjectSchemaStmt *stmt = (AlterObjectSchemaStmt *)pstmt->utilityStmt;
 
-      if (!already_switched_to_superuser) {
-        switch_to_original_role();
-      }
+  if (stmt_role_is_superuser(ctx)) {
+    return false;
+  }
 
-      return;
-    }
+  if (stmt->objectType == OBJECT_EXTENSION &&
+      check_privileged_extension(ctx, strVal(stmt->object))) {
+    run_as_superuser(PROCESS_UTILITY_ARGS, ctx, utility_timer);
 
-    break;
+    return true;
   }
 
-  /*
-   * ALTER EXTENSION <extension> [ ADD | DROP ]
-   *
-   * Not supported. Fall back to normal behavior.
-   */
-  case T_AlterExtensionContentsStmt: break;
+  return false;
+}
 
-  /**
-   * CREATE FOREIGN DATA WRAPPER <fdw>
-   */
-  case T_CreateFdwStmt             : {
-    const Oid current_user_id               = GetUserId();
-    bool      already_switched_to_superuser = false;
+/**
+ * CREATE FOREIGN DATA WRAPPER <fdw>
+ */
+static bool handle_create_fdw(UTILITY_HANDLER_PARAMS) {
+  const Oid current_user_id               = ctx->role_oid;
+  bool      already_switched_to_superuser = false;
 
-    if (superuser()) {
-      break;
-    }
-    if (!is_current_role_privileged()) {
-      break;
-    }
+  if (stmt_role_is_superuser(ctx)) {
+    return false;
+  }
+  if (!is_current_role_privileged(ctx)) {
+    return false;
+  }
 
-    switch_to_superuser(supautils_superuser, &already_switched_to_superuser);
+  if (trace_decision(ctx, "escalate")) return true;
 
-    run_process_utility_hook_with_cleanup(
-        prev_hook, already_switched_to_superuser, switch_to_original_role);
+  switch_to_superuser(supautils_superuser, &already_switched_to_superuser);
 
-    CreateFdwStmt *stmt = (CreateFdwStmt *)utility_stmt;
+  run_process_utility_hook_with_cleanup(
+      prev_hook, already_switched_to_superuser, switch_to_original_role);
 
-    // Change FDW owner to the current role (which is a privileged role)
-    alter_owner(stmt->fdwname, current_user_id, ALT_FDW);
+  CreateFdwStmt *stmt = (CreateFdwStmt *)pstmt->utilityStmt;
 
-    if (!already_switched_to_superuser) {
-      switch_to_original_role();
-    }
+  // Change FDW owner to the current role (which is a privileged role)
+  alter_owner(stmt->fdwname, current_user_id, ALT_FDW);
 
-    return;
+  if (!already_switched_to_superuser) {
+    switch_to_original_role();
   }
 
-  /**
-   * CREATE PUBLICATION
-   */
-  case T_CreatePublicationStmt: {
-    const Oid current_user_id               = GetUserId();
-    bool      already_switched_to_superuser = false;
+  return true;
+}
 
-    if (superuser()) {
-      break;
-    }
-    if (!is_current_role_privileged()) {
-      break;
-    }
+/**
+ * CREATE PUBLICATION
+ */
+static bool handle_create_publication(UTILITY_HANDLER_PARAMS) {
+  const Oid current_user_id               = ctx->role_oid;
+  bool      already_switched_to_superuser = false;
 
-    switch_to_superuser(supautils_superuser, &already_switched_to_superuser);
+  if (stmt_role_is_superuser(ctx)) {
+    return false;
+  }
+  if (!is_current_role_privileged(ctx)) {
+    return false;
+  }
 
-    run_process_utility_hook_with_cleanup(
-        prev_hook, already_switched_to_superuser, switch_to_original_role);
+  if (trace_decision(ctx, "escalate")) return true;
 
-    CreatePublicationStmt *stmt = (CreatePublicationStmt *)utility_stmt;
+  switch_to_superuser(supautils_superuser, &already_switched_to_superuser);
 
-    // Change publication owner to the current role (which is a privileged role)
-    alter_owner(stmt->pubname, current_user_id, ALT_PUB);
+  run_process_utility_hook_with_cleanup(
+      prev_hook, already_switched_to_superuser, switch_to_original_role);
 
-    if (!already_switched_to_superuser) {
-      switch_to_original_role();
-    }
+  CreatePublicationStmt *stmt = (CreatePublicationStmt *)pstmt->utilityStmt;
 
-    return;
+  // Change publication owner to the current role (which is a privileged role)
+  alter_owner(stmt->pubname, current_user_id, ALT_PUB);
+
+  if (!already_switched_to_superuser) {
+    switch_to_original_role();
   }
 
-  /**
-   * ALTER PUBLICATION <name> ADD TABLES IN SCHEMA ...
-   */
-  case T_AlterPublicationStmt: {
-    bool already_switched_to_superuser = false;
+  return true;
+}
 
-    if (superuser()) {
-      break;
-    }
-    if (!is_current_role_privileged()) {
-      break;
-    }
+/**
+ * ALTER PUBLICATION <name> ADD TABLES IN SCHEMA ...
+ */
+static bool handle_alter_publication(UTILITY_HANDLER_PARAMS) {
+  if (stmt_role_is_superuser(ctx)) {
+    return false;
+  }
+  if (!is_current_role_privileged(ctx)) {
+    return false;
+  }
 
-    switch_to_superuser(supautils_superuser, &already_switched_to_superuser);
+  run_as_superuser(PROCESS_UTILITY_ARGS, ctx, utility_timer);
 
-    run_process_utility_hook_with_cleanup(
-        prev_hook, already_switched_to_superuser, switch_to_original_role);
+  return true;
+}
 
-    if (!already_switched_to_superuser) {
-      switch_to_original_role();
-    }
+/**
+ * CREATE POLICY
+ */
+static bool handle_create_policy(UTILITY_HANDLER_PARAMS) {
+  CreatePolicyStmt *stmt = (CreatePolicyStmt *)pstmt->utilityStmt;
 
-    return;
+  if (stmt_role_is_superuser(ctx)) {
+    return false;
   }
 
-  /**
-   * CREATE POLICY
+  if (check_policy_grant(ctx, stmt->table)) {
+    run_as_superuser(PROCESS_UTILITY_ARGS, ctx, utility_timer);
+
+    return true;
+  }
+
+  return false;
+}
+
+/**
+ * ALTER POLICY
+ */
+static bool handle_alter_policy(UTILITY_HANDLER_PARAMS) {
+  AlterPolicyStmt *stmt = (AlterPolicyStmt *)pstmt->utilityStmt;
+
+  if (stmt_role_is_superuser(ctx)) {
+    return false;
+  }
+
+  if (check_policy_grant(ctx, stmt->table)) {
+    run_as_superuser(PROCESS_UTILITY_ARGS, ctx, utility_timer);
+
+    return true;
+  }
+
+  return false;
+}
+
+static bool handle_drop(UTILITY_HANDLER_PARAMS) {
+  DropStmt *stmt = (DropStmt *)pstmt->utilityStmt;
+
+  if (stmt_role_is_superuser(ctx)) {
+    return false;
+  }
+
+  switch (stmt->removeType) {
+  /*
+   * DROP EXTENSION <extension>
    */
-  case T_CreatePolicyStmt: {
-    CreatePolicyStmt *stmt = (CreatePolicyStmt *)utility_stmt;
+  case OBJECT_EXTENSION: {
+    ListCell *lc;
 
-    if (superuser()) {
-      break;
+    foreach (lc, stmt->objects) {
+      if (!check_privileged_extension(ctx, strVal(lfirst(lc)))) return false;
     }
 
-    if (is_current_role_granted_table_policy(stmt->table, pgs, total_pgs)) {
-      bool already_switched_to_superuser = false;
+    run_as_superuser(PROCESS_UTILITY_ARGS, ctx, utility_timer);
+
+    return true;
+  }
 
-      switch_to_superuser(supautils_superuser, &already_switched_to_superuser);
+  /*
+   * DROP POLICY
+   */
+  case OBJECT_POLICY: {
+    // DROP POLICY always has one object.
+    if (!check_policy_grant(ctx,
+                            object_table(linitial_node(List, stmt->objects)))) {
+      return false;
+    }
 
-      run_process_utility_hook_with_cleanup(
-          prev_hook, already_switched_to_superuser, switch_to_original_role);
+    run_as_superuser(PROCESS_UTILITY_ARGS, ctx, utility_timer);
 
-      if (!already_switched_to_superuser) {
-        switch_to_original_role();
-      }
+    return true;
+  }
 
-      return;
+  /*
+   * DROP TRIGGER
+   */
+  case OBJECT_TRIGGER: {
+    // DROP TRIGGER always has one object.
+    if (!check_drop_trigger_grant(
+            ctx, object_table(linitial_node(List, stmt->objects)))) {
+      return false;
     }
 
-    break;
+    run_as_superuser(PROCESS_UTILITY_ARGS, ctx, utility_timer);
+
+    return true;
+  }
+
+  default: return false;
+  }
+}
+
+static bool handle_comment(UTILITY_HANDLER_PARAMS) {
+  CommentStmt *stmt = (CommentStmt *)pstmt->utilityStmt;
+
+  if (!IsTransactionState()) {
+    return false;
+  }
+  if (stmt_role_is_superuser(ctx)) {
+    return false;
   }
 
   /**
-   * ALTER POLICY
+   * COMMENT ON POLICY
    */
-  case T_AlterPolicyStmt: {
-    AlterPolicyStmt *stmt = (AlterPolicyStmt *)utility_stmt;
-
-    if (superuser()) {
-      break;
+  if (stmt->objtype == OBJECT_POLICY) {
+    if (!check_policy_grant(ctx, object_table(castNode(List, stmt->object)))) {
+      return false;
     }
 
-    if (is_current_role_granted_table_policy(stmt->table, pgs, total_pgs)) {
-      bool already_switched_to_superuser = false;
+    run_as_superuser(PROCESS_UTILITY_ARGS, ctx, utility_timer);
 
-      switch_to_superuser(supautils_superuser, &already_switched_to_superuser);
+    return true;
+  }
 
-      run_process_utility_hook_with_cleanup(
-          prev_hook, already_switched_to_superuser, switch_to_original_role);
+  if (stmt->objtype != OBJECT_EXTENSION) {
+    return false;
+  }
+  if (!is_current_role_privileged(ctx)) {
+    return false;
+  }
 
-      if (!already_switched_to_superuser) {
-        switch_to_original_role();
-      }
+  run_as_superuser(PROCESS_UTILITY_ARGS, ctx, utility_timer);
 
-      return;
-    }
+  return true;
+}
 
-    break;
+static bool handle_variable_set(UTILITY_HANDLER_PARAMS) {
+  VariableSetStmt *stmt = (VariableSetStmt *)pstmt->utilityStmt;
+  List            *clamped;
+
+  if (!IsTransactionState()) {
+    return false;
+  }
+  if (stmt_role_is_superuser(ctx)) {
+    return false;
+  }
+  if (!check_allowed_config(ctx, stmt->name)) {
+    return false;
+  }
+  if (!is_current_role_privileged(ctx)) {
+    return false;
   }
 
-  case T_DropStmt: {
-    DropStmt *stmt = (DropStmt *)utility_stmt;
+  clamped = apply_config_ceiling(stmt, config_ceilings, total_config_ceilings,
+                                 config_ceilings_mode);
+  trace_check(ctx, "config_ceiling", stmt->name,
+              clamped != NIL ? "clamped" : "none");
 
-    if (superuser()) {
-      break;
-    }
+  // the statement may be cached, so the clamped value is set on a copy
+  if (clamped != NIL) {
+    pstmt = copyObject(pstmt);
+    ((VariableSetStmt *)pstmt->utilityStmt)->args = clamped;
+  }
 
-    switch (stmt->removeType) {
-    /*
-     * DROP EXTENSION <extension>
-     */
-    case OBJECT_EXTENSION: {
-      if (all_extensions_are_privileged(stmt->objects, privileged_extensions)) {
-        bool already_switched_to_superuser = false;
-        switch_to_superuser(supautils_superuser,
-                            &already_switched_to_superuser);
+  run_as_superuser(PROCESS_UTILITY_ARGS, ctx, utility_timer);
 
-        run_process_utility_hook_with_cleanup(
-            prev_hook, already_switched_to_superuser, switch_to_original_role);
+  return true;
+}
 
-        if (!already_switched_to_superuser) {
-          switch_to_original_role();
-        }
+static bool handle_create_event_trigger(UTILITY_HANDLER_PARAMS) {
+  bool      already_switched_to_superuser = false;
+  const Oid current_user_id               = ctx->role_oid;
 
-        return;
-      }
+  CreateEventTrigStmt *stmt = (CreateEventTrigStmt *)pstmt->utilityStmt;
 
-      break;
-    }
+  if (!IsTransactionState()) {
+    return false;
+  }
 
-    /*
-     * DROP POLICY
-     */
-    case OBJECT_POLICY: {
-      // DROP POLICY always has one object.
-      ListCell *object_cell = list_head(stmt->objects);
-      List     *object      = castNode(List, lfirst(object_cell));
-      // Last element is the policy name, the rest is the table name.
-      // Take everything but the last.
-      List *table_name_list =
-          list_truncate(list_copy(object), list_length(object) - 1);
-      RangeVar *table_range_var = makeRangeVarFromNameList(table_name_list);
-      bool      already_switched_to_superuser = false;
-
-      if (!is_current_role_granted_table_policy(table_range_var, pgs,
-                                                total_pgs)) {
-        break;
-      }
+  if (!is_current_role_privileged(ctx)) {
+    return false;
+  }
+
+  bool       current_user_is_super = stmt_role_is_superuser(ctx);
+  func_attrs fattrs =
+      get_function_attrs((func_search){FO_SEARCH_NAME, {stmt->funcname}});
+  bool function_is_owned_by_super = superuser_arg(fattrs.owner);
+
+  if (!current_user_is_super && function_is_owned_by_super) {
+    ereport(ERROR, (errmsg("Non-superuser owned event trigger must execute "
+                           "a non-superuser owned function"),
+                    errdetail("The current user \"%s\" is not a superuser "
+                              "and the function \"%s\" is "
+                              "owned by a superuser",
+                              stmt_role_name(ctx),
+                              NameListToString(stmt->funcname))));
+  }
 
-      switch_to_superuser(supautils_superuser, &already_switched_to_superuser);
+  if (current_user_is_super && !function_is_owned_by_super) {
+    ereport(ERROR, (errmsg("Superuser owned event trigger must execute a "
+                           "superuser owned function"),
+                    errdetail("The current user \"%s\" is a superuser and "
+                              "the function \"%s\" is "
+                              "owned by a non-superuser",
+                              stmt_role_name(ctx),
+                              NameListToString(stmt->funcname))));
+  }
 
-      run_process_utility_hook_with_cleanup(
-          prev_hook, already_switched_to_superuser, switch_to_original_role);
+  if (trace_decision(ctx, "escalate")) return true;
 
-      if (!already_switched_to_superuser) {
-        switch_to_original_role();
-      }
+  switch_to_superuser(supautils_superuser, &already_switched_to_superuser);
 
-      return;
-    }
+  run_process_utility_hook_with_cleanup(
+      prev_hook, already_switched_to_superuser, switch_to_original_role);
 
-    /*
-     * DROP TRIGGER
-     */
-    case OBJECT_TRIGGER: {
-      // DROP TRIGGER always has one object.
-      ListCell *object_cell = list_head(stmt->objects);
-      List     *object      = castNode(List, lfirst(object_cell));
-      // Last element is the trigger name, the rest is the table name.
-      // Take everything but the last.
-      List *table_name_list =
-          list_truncate(list_copy(object), list_length(object) - 1);
-      RangeVar *table_range_var = makeRangeVarFromNameList(table_name_list);
-      bool      already_switched_to_superuser = false;
-
-      if (!is_current_role_granted_table_drop_trigger(table_range_var, dtgs,
-                                                      total_dtgs)) {
-        break;
-      }
+  if (!current_user_is_super)
+    // Change event trigger owner to the current role (which is a privileged
+    // role)
+    alter_owner(stmt->trigname, current_user_id, ALT_EVTRIG);
 
-      switch_to_superuser(supautils_superuser, &already_switched_to_superuser);
+  if (!already_switched_to_superuser) {
+    switch_to_original_role();
+  }
 
-      run_process_utility_hook_with_cleanup(
-          prev_hook, already_switched_to_superuser, switch_to_original_role);
+  return true;
+}
 
-      if (!already_switched_to_superuser) {
-        switch_to_original_role();
-      }
+/*
+ * ALTER TABLE <table> ...
+ */
+static bool handle_alter_table(UTILITY_HANDLER_PARAMS) {
+  if (stmt_role_is_superuser(ctx)) {
+    return false;
+  }
 
-      return;
-    }
+  guard_alter_table((AlterTableStmt *)pstmt->utilityStmt, ddl_guard,
+                    ddl_guard_size, ctx);
 
-    default: break;
-    }
+  return false;
+}
 
-    break;
+/*
+ * CREATE INDEX ON <table>
+ */
+static bool handle_index(UTILITY_HANDLER_PARAMS) {
+  if (stmt_role_is_superuser(ctx)) {
+    return false;
   }
 
-  case T_CommentStmt: {
-    if (!IsTransactionState()) {
-      break;
-    }
-    if (superuser()) {
-      break;
-    }
+  guard_index((IndexStmt *)pstmt->utilityStmt, ddl_guard, ddl_guard_size,
+              ctx);
 
-    /**
-     * COMMENT ON POLICY
-     */
-    if (((CommentStmt *)utility_stmt)->objtype == OBJECT_POLICY) {
-      CommentStmt *stmt   = (CommentStmt *)utility_stmt;
-      List        *object = castNode(List, stmt->object);
-      List        *table_name_list =
-          list_truncate(list_copy(object), list_length(object) - 1);
-      RangeVar *table_range_var = makeRangeVarFromNameList(table_name_list);
-      bool      already_switched_to_superuser = false;
-
-      if (!is_current_role_granted_table_policy(table_range_var, pgs,
-                                                total_pgs)) {
-        break;
-      }
+  return false;
+}
 
-      switch_to_superuser(supautils_superuser, &already_switched_to_superuser);
+/*
+ * REINDEX [ INDEX | TABLE ] <relation>
+ */
+static bool handle_reindex(UTILITY_HANDLER_PARAMS) {
+  if (stmt_role_is_superuser(ctx)) {
+    return false;
+  }
 
-      run_process_utility_hook_with_cleanup(
-          prev_hook, already_switched_to_superuser, switch_to_original_role);
+  guard_reindex((ReindexStmt *)pstmt->utilityStmt, ddl_guard, ddl_guard_size,
+                ctx);
 
-      if (!already_switched_to_superuser) {
-        switch_to_original_role();
-      }
+  return false;
+}
 
-      return;
-    }
+#pragma GCC diagnostic pop
 
-    if (((CommentStmt *)utility_stmt)->objtype != OBJECT_EXTENSION) {
-      break;
-    }
-    if (!is_current_role_privileged()) {
-      break;
-    }
+typedef enum {
+  FEATURE_RESERVED_ROLES          = 1 << 0,
+  FEATURE_RESERVED_MEMBERSHIPS    = 1 << 1,
+  FEATURE_PRIVILEGED_ROLE         = 1 << 2,
+  FEATURE_PRIVILEGED_ROLE_CONFIGS = 1 << 3,
+  FEATURE_PRIVILEGED_EXTENSIONS   = 1 << 4,
+  FEATURE_EXTENSION_OPTIONS       = 1 << 5,
+  FEATURE_EXTENSION_CHECKS        = 1 << 6,
+  FEATURE_POLICY_GRANTS           = 1 << 7,
+  FEATURE_DROP_TRIGGER_GRANTS     = 1 << 8,
+  FEATURE_DDL_GUARD               = 1 << 9,
+} utility_feature;
+
+typedef struct {
+  NodeTag         tag;
+  int             features;
+  utility_handler handler;
+} utility_handler_entry;
+
+// A handler is only dispatched to when at least one of its features is enabled
+static const utility_handler_entry utility_handlers[] = {
+  {T_AlterRoleStmt, FEATURE_RESERVED_ROLES | FEATURE_PRIVILEGED_ROLE,
+   handle_alter_role},
+  {T_AlterRoleSetStmt,
+   FEATURE_RESERVED_ROLES | FEATURE_PRIVILEGED_ROLE_CONFIGS,
+   handle_alter_role_set},
+  {T_CreateRoleStmt,
+   FEATURE_RESERVED_ROLES | FEATURE_RESERVED_MEMBERSHIPS |
+       FEATURE_PRIVILEGED_ROLE,
+   handle_create_role},
+  {T_DropRoleStmt, FEATURE_RESERVED_ROLES, handle_drop_role},
+  {T_GrantRoleStmt, FEATURE_RESERVED_ROLES | FEATURE_RESERVED_MEMBERSHIPS,
+   handle_grant_role},
+  {T_RenameStmt, FEATURE_RESERVED_ROLES, handle_rename},
+  {T_CreateExtensionStmt,
+   FEATURE_PRIVILEGED_EXTENSIONS | FEATURE_EXTENSION_OPTIONS |
+       FEATURE_EXTENSION_CHECKS,
+   handle_create_extension},
+  {T_AlterExtensionStmt,
+   FEATURE_PRIVILEGED_EXTENSIONS | FEATURE_EXTENSION_OPTIONS |
+       FEATURE_EXTENSION_CHECKS,
+   handle_alter_extension},
+  {T_AlterObjectSchemaStmt, FEATURE_PRIVILEGED_EXTENSIONS,
+   handle_alter_object_schema},
+  {T_CreateFdwStmt, FEATURE_PRIVILEGED_ROLE, handle_create_fdw},
+  {T_CreatePublicationStmt, FEATURE_PRIVILEGED_ROLE,
+   handle_create_publication},
+  {T_AlterPublicationStmt, FEATURE_PRIVILEGED_ROLE, handle_alter_publication},
+  {T_CreatePolicyStmt, FEATURE_POLICY_GRANTS, handle_create_policy},
+  {T_AlterPolicyStmt, FEATURE_POLICY_GRANTS, handle_alter_policy},
+  {T_DropStmt,
+   FEATURE_PRIVILEGED_EXTENSIONS | FEATURE_POLICY_GRANTS |
+       FEATURE_DROP_TRIGGER_GRANTS,
+   handle_drop},
+  {T_CommentStmt, FEATURE_POLICY_GRANTS | FEATURE_PRIVILEGED_ROLE,
+   handle_comment},
+  {T_VariableSetStmt, FEATURE_PRIVILEGED_ROLE_CONFIGS, handle_variable_set},
+  {T_CreateEventTrigStmt, FEATURE_PRIVILEGED_ROLE,
+   handle_create_event_trigger},
+  {T_AlterTableStmt, FEATURE_DDL_GUARD, handle_alter_table},
+  {T_IndexStmt, FEATURE_DDL_GUARD, handle_index},
+  {T_ReindexStmt, FEATURE_DDL_GUARD, handle_reindex},
+};
+
+// the handlers of the enabled features, rebuilt after the GUCs change
+static utility_handler_entry dispatch[lengthof(utility_handlers)];
+static size_t                total_dispatch = 0;
+static bool                  dispatch_stale = true;
+
+static bool is_set(const char *val) { return val != NULL && val[0] != '\0'; }
+
+static int enabled_features(void) {
+  int features = 0;
+
+  if (is_set(reserved_roles)) features |= FEATURE_RESERVED_ROLES;
+  if (is_set(reserved_memberships)) features |= FEATURE_RESERVED_MEMBERSHIPS;
+  if (is_set(privileged_role)) features |= FEATURE_PRIVILEGED_ROLE;
+  if (is_set(privileged_role) && is_set(privileged_role_allowed_configs))
+    features |= FEATURE_PRIVILEGED_ROLE_CONFIGS;
+  if (is_set(privileged_extensions)) features |= FEATURE_PRIVILEGED_EXTENSIONS;
+  if (total_epos > 0 ||
+      restrict_extension_versions != RESTRICT_EXTENSION_VERSIONS_OFF)
+    features |= FEATURE_EXTENSION_OPTIONS;
+  if (total_cexts > 0 || is_set(extension_custom_scripts_path))
+    features |= FEATURE_EXTENSION_CHECKS;
+  if (total_pgs > 0) features |= FEATURE_POLICY_GRANTS;
+  if (total_dtgs > 0) features |= FEATURE_DROP_TRIGGER_GRANTS;
+  if (ddl_guard != DDL_GUARD_OFF) features |= FEATURE_DDL_GUARD;
+
+  return features;
+}
 
-    {
-      bool already_switched_to_superuser = false;
-      switch_to_superuser(supautils_superuser, &already_switched_to_superuser);
+static utility_handler find_utility_handler(NodeTag tag) {
+  if (dispatch_stale) {
+    int features = enabled_features();
 
-      run_process_utility_hook_with_cleanup(
-          prev_hook, already_switched_to_superuser, switch_to_original_role);
+    // report a misconfigured supautils.superuser once after a reload
+    validate_superuser(supautils_superuser);
 
-      if (!already_switched_to_superuser) {
-        switch_to_original_role();
-      }
+    total_dispatch = 0;
+    for (size_t i = 0; i < lengthof(utility_handlers); i++)
+      if (utility_handlers[i].features & features)
+        dispatch[total_dispatch++] = utility_handlers[i];
 
-      return;
-    }
+    dispatch_stale = false;
   }
 
-  case T_VariableSetStmt: {
-    if (!IsTransactionState()) {
-      break;
-    }
-    if (superuser()) {
-      break;
-    }
-    if (privileged_role_allowed_configs == NULL) {
-      break;
-    } else {
-      bool is_privileged_role_allowed_config =
-          is_string_in_comma_delimited_string(
-              ((VariableSetStmt *)utility_stmt)->name,
-              privileged_role_allowed_configs);
-
-      if (!is_privileged_role_allowed_config) {
-        break;
-      }
-    }
-    if (!is_current_role_privileged()) {
-      break;
-    }
+  for (size_t i = 0; i < total_dispatch; i++)
+    if (dispatch[i].tag == tag) return dispatch[i].handler;
 
-    {
-      bool already_switched_to_superuser = false;
-      switch_to_superuser(supautils_superuser, &already_switched_to_superuser);
+  return NULL;
+}
+
+// Statements left to the chained hooks are not audited, supautils didn't act
+// on them. Unless the handler switched to supautils.superuser before leaving
+// the statement to them, like ALTER EXTENSION does, then the record has the
+// outcome of the chained run.
+static void run_audited_statement(utility_handler handler,
+                                  UTILITY_HANDLER_PARAMS) {
+  audit_record  rec;
+  volatile Oid  escalated_to = InvalidOid;
+  volatile bool chained      = false;
+
+  audit_start(&rec, ctx->role_oid, pstmt->utilityStmt);
+  take_escalated_role();
+
+  PG_TRY();
+  {
+    chained      = !handler(PROCESS_UTILITY_ARGS, ctx, utility_timer);
+    escalated_to = take_escalated_role();
+
+    if (chained) {
+      run_process_utility_hook(prev_hook);
+    }
+  }
+  PG_CATCH();
+  {
+    if (!chained) escalated_to = take_escalated_role();
+    if (!chained || OidIsValid(escalated_to))
+      audit_finish(&rec, escalated_to, false);
+    PG_RE_THROW();
+  }
+  PG_END_TRY();
 
-      run_process_utility_hook_with_cleanup(
-          prev_hook, already_switched_to_superuser, switch_to_original_role);
+  if (!chained || OidIsValid(escalated_to))
+    audit_finish(&rec, escalated_to, true);
+}
 
-      if (!already_switched_to_superuser) {
-        switch_to_original_role();
-      }
+static void supautils_process_utility(PROCESS_UTILITY_PARAMS,
+                                      hook_timer *utility_timer) {
+  utility_handler handler = find_utility_handler(nodeTag(pstmt->utilityStmt));
+  stmt_context    ctx     = {.role_oid = GetUserId()};
 
-      return;
-    }
+  if (handler != NULL && audit_enabled()) {
+    run_audited_statement(handler, PROCESS_UTILITY_ARGS, &ctx, utility_timer);
+    return;
   }
 
-  case T_CreateEventTrigStmt: {
-    if (!IsTransactionState()) {
-      break;
-    }
+  if (handler != NULL && handler(PROCESS_UTILITY_ARGS, &ctx, utility_timer))
+    return;
 
-    if (!is_current_role_privileged()) {
-      break;
-    }
+  /* Chain to previously defined hooks */
+  run_process_utility_hook(prev_hook);
+}
 
-    {
-      bool      already_switched_to_superuser = false;
-      const Oid current_user_id               = GetUserId();
-
-      CreateEventTrigStmt *stmt = (CreateEventTrigStmt *)utility_stmt;
-
-      bool       current_user_is_super = superuser_arg(current_user_id);
-      func_attrs fattrs =
-          get_function_attrs((func_search){FO_SEARCH_NAME, {stmt->funcname}});
-      bool function_is_owned_by_super = superuser_arg(fattrs.owner);
-
-      if (!current_user_is_super && function_is_owned_by_super) {
-        ereport(ERROR, (errmsg("Non-superuser owned event trigger must execute "
-                               "a non-superuser owned function"),
-                        errdetail("The current user \"%s\" is not a superuser "
-                                  "and the function \"%s\" is "
-                                  "owned by a superuser",
-                                  GetUserNameFromId(current_user_id, false),
-                                  NameListToString(stmt->funcname))));
-      }
+static void supautils_hook(PROCESS_UTILITY_PARAMS) {
+  hook_timer timer;
 
-      if (current_user_is_super && !function_is_owned_by_super) {
-        ereport(ERROR, (errmsg("Superuser owned event trigger must execute a "
-                               "superuser owned function"),
-                        errdetail("The current user \"%s\" is a superuser and "
-                                  "the function \"%s\" is "
-                                  "owned by a non-superuser",
-                                  GetUserNameFromId(current_user_id, false),
-                                  NameListToString(stmt->funcname))));
-      }
+  // the object is only looked up for an attached tracer
+  if (TRACE_SUPAUTILS_UTILITY_START_ENABLED())
+    TRACE_SUPAUTILS_UTILITY_START(nodeTag(pstmt->utilityStmt), GetUserId(),
+                                  statement_object(pstmt->utilityStmt));
+  hook_timer_start(&timer, track_hook_latency);
 
-      switch_to_superuser(supautils_superuser, &already_switched_to_superuser);
+  supautils_process_utility(PROCESS_UTILITY_ARGS, &timer);
 
-      run_process_utility_hook_with_cleanup(
-          prev_hook, already_switched_to_superuser, switch_to_original_role);
+  hook_timer_stop(&timer, utility_hook_series(nodeTag(pstmt->utilityStmt)));
+  if (TRACE_SUPAUTILS_UTILITY_DONE_ENABLED())
+    TRACE_SUPAUTILS_UTILITY_DONE(nodeTag(pstmt->utilityStmt), GetUserId(),
+                                 statement_object(pstmt->utilityStmt));
+}
 
-      if (!current_user_is_super)
-        // Change event trigger owner to the current role (which is a privileged
-        // role)
-        alter_owner(stmt->trigname, current_user_id, ALT_EVTRIG);
+// Assign hooks run before the new value is set, so the dispatch table is
+// rebuilt on the next utility statement instead.
+static void dispatch_assign_hook(__attribute__((unused)) const char *newval,
+                                 __attribute__((unused)) void       *extra) {
+  dispatch_stale = true;
+}
 
-      if (!already_switched_to_superuser) {
-        switch_to_original_role();
-      }
+static bool superuser_check_hook(char                            **newval,
+                                  __attribute__((unused)) void    **extra,
+                                  __attribute__((unused)) GucSource source) {
+  // the role can only be looked up inside a transaction, e.g. on ALTER SYSTEM,
+  // parallel workers get the value from their leader which already checked it
+  if (*newval && IsTransactionState() && !IsParallelWorker())
+    check_superuser(*newval, WARNING);
 
-      return;
-    }
-  }
+  return true;
+}
 
-  default: break;
-  }
+static void superuser_assign_hook(__attribute__((unused)) const char *newval,
+                                  __attribute__((unused)) void       *extra) {
+  invalidate_superuser_oid();
+  dispatch_stale = true;
+}
 
-  /* Chain to previously defined hooks */
-  run_process_utility_hook(prev_hook);
+static void
+escalated_lock_timeout_assign_hook(int                           newval,
+                                   __attribute__((unused)) void *extra) {
+  set_escalated_lock_timeout(newval);
+}
+
+static void dispatch_enum_assign_hook(__attribute__((unused)) int   newval,
+                                      __attribute__((unused)) void *extra) {
+  dispatch_stale = true;
 }
 
 static void clear_extensions_parameter_overrides_array(
@@ -1163,6 +1551,7 @@ static bool extensions_parameter_overrides_check_hook(
 static void extensions_parameter_overrides_assign_hook(
     const char *newval, __attribute__((unused)) void *extra) {
   clear_extensions_parameter_overrides();
+  dispatch_stale = true;
 
   if (newval) {
     json_extension_parameter_overrides_parse_state state =
@@ -1248,6 +1637,13 @@ reserved_memberships_check_hook(char                            **newval,
   return true;
 }
 
+static void
+reserved_memberships_assign_hook(__attribute__((unused)) const char *newval,
+                                 __attribute__((unused)) void       *extra) {
+  invalidate_reserved_memberships();
+  dispatch_stale = true;
+}
+
 static bool placeholders_disallowed_values_check_hook(
     char **newval, __attribute__((unused)) void **extra,
     __attribute__((unused)) GucSource source) {
@@ -1256,6 +1652,17 @@ static bool placeholders_disallowed_values_check_hook(
   return true;
 }
 
+static void placeholders_disallowed_values_assign_hook(
+    const char *newval, __attribute__((unused)) void *extra) {
+  MemoryContext cxt = get_memory_context(MEMCXT_PLACEHOLDERS);
+
+  MemoryContextReset(cxt);
+  compiled_disallowed_values = NULL;
+
+  if (newval && newval[0] != '\0')
+    compiled_disallowed_values = compile_disallowed_values(newval, cxt);
+}
+
 static bool
 privileged_extensions_check_hook(char                            **newval,
                                  __attribute__((unused)) void    **extra,
@@ -1273,6 +1680,64 @@ static bool hint_roles_check_hook(char                            **newval,
   return true;
 }
 
+static int check_bypass_processes(const char *val, const char *name) {
+  int         types   = 0;
+  const char *unknown = NULL;
+
+  if (val != NULL && !parse_process_types(val, &types, &unknown))
+    ereport(ERROR,
+            (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+             errmsg("%s: unknown process type \"%s\"", name, unknown),
+             errhint("Valid process types are parallel_worker, autovacuum, "
+                     "walsender and background_worker.")));
+
+  return types;
+}
+
+static bool executor_start_bypass_processes_check_hook(
+    char **newval, __attribute__((unused)) void **extra,
+    __attribute__((unused)) GucSource source) {
+  check_bypass_processes(*newval, "supautils.executor_start_bypass_processes");
+
+  return true;
+}
+
+static void executor_start_bypass_processes_assign_hook(
+    const char *newval, __attribute__((unused)) void *extra) {
+  const char *unknown;
+
+  executor_start_bypass_processes = 0;
+  if (newval)
+    parse_process_types(newval, &executor_start_bypass_processes, &unknown);
+}
+
+static bool
+fmgr_bypass_processes_check_hook(char                            **newval,
+                                 __attribute__((unused)) void    **extra,
+                                 __attribute__((unused)) GucSource source) {
+  int types =
+      check_bypass_processes(*newval, "supautils.fmgr_bypass_processes");
+
+  // DDL, and so event triggers, can run on these
+  if (types & (PROCESS_WALSENDER | PROCESS_BACKGROUND_WORKER))
+    ereport(ERROR,
+            (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+             errmsg("supautils.fmgr_bypass_processes: event triggers can fire "
+                    "on walsender and background_worker processes"),
+             errhint("Only parallel_worker and autovacuum can be bypassed.")));
+
+  return true;
+}
+
+static void
+fmgr_bypass_processes_assign_hook(const char                   *newval,
+                                  __attribute__((unused)) void *extra) {
+  const char *unknown;
+
+  fmgr_bypass_processes = 0;
+  if (newval) parse_process_types(newval, &fmgr_bypass_processes, &unknown);
+}
+
 static bool privileged_role_allowed_configs_check_hook(
     char **newval, __attribute__((unused)) void **extra,
     __attribute__((unused)) GucSource source) {
@@ -1292,6 +1757,54 @@ static void check_parameter(char *val, char *name) {
   }
 }
 
+static void clear_config_ceilings_array(config_ceiling *target,
+                                        size_t          count) {
+  for (size_t i = 0; i < count; i++) {
+    if (target[i].name != NULL) pfree(target[i].name);
+    if (target[i].ceiling != NULL) pfree(target[i].ceiling);
+  }
+  memset(target, 0, sizeof(config_ceiling) * count);
+}
+
+static bool
+config_ceilings_check_hook(char                            **newval,
+                           __attribute__((unused)) void    **extra,
+                           __attribute__((unused)) GucSource source) {
+  config_ceiling tmp_ceilings[MAX_CONFIG_CEILINGS] = {0};
+
+  if (*newval) {
+    json_config_ceilings_parse_state state =
+        parse_config_ceilings(*newval, tmp_ceilings);
+
+    clear_config_ceilings_array(tmp_ceilings, MAX_CONFIG_CEILINGS);
+
+    if (state.error_msg) {
+      ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                      errmsg("supautils.privileged_role_config_ceilings: %s",
+                             state.error_msg)));
+    }
+  }
+
+  return true;
+}
+
+static void config_ceilings_assign_hook(const char                   *newval,
+                                        __attribute__((unused)) void *extra) {
+  clear_config_ceilings_array(config_ceilings, MAX_CONFIG_CEILINGS);
+  total_config_ceilings = 0;
+
+  if (newval) {
+    json_config_ceilings_parse_state state =
+        parse_config_ceilings(newval, config_ceilings);
+    if (state.error_msg) {
+      ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                      errmsg("supautils.privileged_role_config_ceilings: %s",
+                             state.error_msg)));
+    }
+    total_config_ceilings = state.total_ceilings;
+  }
+}
+
 static void clear_constrained_extensions(void) {
   if (total_cexts > 0) {
     for (size_t i = 0; i < total_cexts; i++) {
@@ -1330,6 +1843,7 @@ static void
 constrained_extensions_assign_hook(const char                   *newval,
                                    __attribute__((unused)) void *extra) {
   clear_constrained_extensions();
+  dispatch_stale = true;
 
   if (newval) {
     json_constrained_extension_parse_state state =
@@ -1400,23 +1914,68 @@ static bool is_hint_role(const char *target) {
   return false;
 }
 
-static void confirm_reserved_memberships(const char *target) {
+static bool is_reserved_membership(const char *target) {
   List     *reserved_memberships_list;
   ListCell *membership;
+  bool      found = false;
 
-  if (reserved_memberships) {
-    SplitIdentifierString(pstrdup(reserved_memberships), ',',
-                          &reserved_memberships_list);
+  if (!reserved_memberships) return false;
 
-    foreach (membership, reserved_memberships_list) {
-      char *reserved_membership = (char *)lfirst(membership);
+  SplitIdentifierString(pstrdup(reserved_memberships), ',',
+                        &reserved_memberships_list);
 
-      if (strcmp(target, reserved_membership) == 0) {
-        list_free(reserved_memberships_list);
-        EREPORT_RESERVED_MEMBERSHIP(reserved_membership);
-      }
+  foreach (membership, reserved_memberships_list) {
+    if (strcmp(target, (char *)lfirst(membership)) == 0) {
+      found = true;
+      break;
     }
-    list_free(reserved_memberships_list);
+  }
+  list_free(reserved_memberships_list);
+
+  return found;
+}
+
+// granting a member of a reserved role also grants the reserved role, returns
+// that reserved role or InvalidOid
+static Oid transitive_reserved_membership(const char *target) {
+  Oid target_oid;
+
+  if (!reserved_memberships || !transitive_reserved_memberships)
+    return InvalidOid;
+
+  target_oid = get_role_oid(target, true);
+
+  return OidIsValid(target_oid)
+             ? find_reserved_membership(target_oid, reserved_memberships)
+             : InvalidOid;
+}
+
+static void confirm_reserved_memberships(stmt_context *ctx,
+                                         const char   *target) {
+  bool reserved = is_reserved_membership(target);
+  Oid  reserved_role;
+
+  trace_check(ctx, "reserved_membership", target, trace_bool(reserved));
+
+  if (reserved) EREPORT_RESERVED_MEMBERSHIP(target);
+
+  reserved_role = transitive_reserved_membership(target);
+
+  if (stmt_is_explained(ctx) && transitive_reserved_memberships)
+    trace_check(ctx, "transitive_reserved_membership", target,
+                OidIsValid(reserved_role)
+                    ? GetUserNameFromId(reserved_role, false)
+                    : "false");
+
+  if (OidIsValid(reserved_role)) {
+    stats_incr(STAT_RESERVED_MEMBERSHIP_REJECTED);
+    ereport(ERROR,
+            (errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+             errmsg("\"%s\" role memberships are reserved, only "
+                    "superusers can grant them",
+                    target),
+             errdetail("\"%s\" is a member of the reserved \"%s\" role.",
+                       target, GetUserNameFromId(reserved_role, false))));
   }
 }
 
@@ -1455,44 +2014,51 @@ static bool
 restrict_placeholders_check_hook(char                            **newval,
                                  __attribute__((unused)) void    **extra,
                                  __attribute__((unused)) GucSource source) {
-  bool not_empty = placeholders_disallowed_values &&
-                   placeholders_disallowed_values[0] != '\0';
-
-  if (*newval && not_empty) {
-    char *token, *string, *tofree;
-    char *val = str_tolower(*newval, strlen(*newval), DEFAULT_COLLATION_OID);
-
-    tofree = string = pstrdup(placeholders_disallowed_values);
-
-    while ((token = strsep(&string, ",")) != NULL) {
-      if (strstr(val, token)) {
-        GUC_check_errcode(ERRCODE_INVALID_PARAMETER_VALUE);
-        GUC_check_errmsg("The placeholder contains the \"%s\" disallowed value",
-                         token);
-        pfree(tofree);
-        pfree(val);
-        return false;
-      }
-    }
+  // bounded so a huge value isn't scanned just to be rejected
+  if (*newval && placeholders_max_length > 0 &&
+      strnlen(*newval, placeholders_max_length + 1) >
+          (size_t)placeholders_max_length) {
+    GUC_check_errcode(ERRCODE_INVALID_PARAMETER_VALUE);
+    GUC_check_errmsg("The placeholder value is longer than %d bytes",
+                     placeholders_max_length);
+    return false;
+  }
 
-    pfree(tofree);
-    pfree(val);
+  if (*newval && compiled_disallowed_values) {
+    const char *token =
+        find_disallowed_value(compiled_disallowed_values, *newval);
+
+    if (token) {
+      GUC_check_errcode(ERRCODE_INVALID_PARAMETER_VALUE);
+      GUC_check_errmsg("The placeholder contains the \"%s\" disallowed value",
+                       token);
+      return false;
+    }
   }
 
   return true;
 }
 
-static bool is_current_role_privileged(void) {
-  Oid current_role_oid = GetUserId();
+static bool is_current_role_privileged(stmt_context *ctx) {
   Oid privileged_role_oid;
 
-  if (privileged_role == NULL) {
-    return false;
+  if (ctx->privileged_checked) return ctx->is_privileged;
+
+  ctx->privileged_checked = true;
+  ctx->is_privileged      = false;
+
+  if (privileged_role != NULL) {
+    privileged_role_oid = get_role_oid(privileged_role, true);
+
+    ctx->is_privileged = OidIsValid(privileged_role_oid) &&
+                         has_privs_of_role(ctx->role_oid, privileged_role_oid);
   }
-  privileged_role_oid = get_role_oid(privileged_role, true);
 
-  return OidIsValid(privileged_role_oid) &&
-         has_privs_of_role(current_role_oid, privileged_role_oid);
+  if (stmt_is_explained(ctx))
+    trace_check(ctx, "privileged_role", stmt_role_name(ctx),
+                trace_bool(ctx->is_privileged));
+
+  return ctx->is_privileged;
 }
 
 static bool is_role_privileged(const char *role) {
@@ -1508,6 +2074,145 @@ static bool is_role_privileged(const char *role) {
          has_privs_of_role(role_oid, privileged_role_oid);
 }
 
+// Creates a batch of roles with the reserved roles and memberships checked for
+// the whole batch upfront, instead of per CREATE ROLE statement
+PG_FUNCTION_INFO_V1(supautils_provision_roles);
+Datum supautils_provision_roles(PG_FUNCTION_ARGS) {
+  ReturnSetInfo *rsinfo = (ReturnSetInfo *)fcinfo->resultinfo;
+  List          *roles  = parse_provisioned_roles(PG_GETARG_JSONB_P(0));
+  stmt_context   ctx    = {.role_oid = GetUserId()};
+  ListCell      *lc;
+
+  InitMaterializedSRF(fcinfo, 0);
+
+  if (!superuser()) {
+    foreach (lc, roles) {
+      provisioned_role *role = lfirst(lc);
+      ListCell         *member_of_cell;
+
+      confirm_reserved_role(&ctx, role->name, false);
+
+      foreach (member_of_cell, role->member_of)
+        confirm_reserved_memberships(&ctx, lfirst(member_of_cell));
+    }
+  }
+
+  foreach (lc, roles) {
+    provisioned_role *role = lfirst(lc);
+    Datum             values[2];
+    bool              nulls[2] = {0};
+    const char       *status   = "created";
+
+    // existing roles only get their missing memberships, so a batch can be
+    // retried or extended
+    if (OidIsValid(get_role_oid(role->name, true)))
+      status = grant_provisioned_memberships(role) ? "updated" : "exists";
+    else
+      create_provisioned_role(role);
+
+    values[0] = CStringGetTextDatum(role->name);
+    values[1] = CStringGetTextDatum(status);
+
+    tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+  }
+
+  return (Datum)0;
+}
+
+// Traces the checks supautils does for a utility statement, as the current
+// role. The statement goes through its handler, which stops before running it,
+// in a subtransaction that is always rolled back. So whatever the handler did
+// is undone and the locks taken by the checks are released, only the trace is
+// kept, it's written in this function's context and resource owner.
+PG_FUNCTION_INFO_V1(supautils_explain);
+Datum supautils_explain(PG_FUNCTION_ARGS) {
+  char           *query    = text_to_cstring(PG_GETARG_TEXT_PP(0));
+  explain_trace   trace    = {.rsinfo = (ReturnSetInfo *)fcinfo->resultinfo,
+                              .owner  = CurrentResourceOwner};
+  stmt_context    ctx      = {.role_oid = GetUserId(), .trace = &trace};
+  MemoryContext   oldcxt   = CurrentMemoryContext;
+  ResourceOwner   oldowner = CurrentResourceOwner;
+  List           *parsetrees;
+  PlannedStmt    *pstmt;
+  utility_handler handler;
+  char           *rejected = NULL;
+
+  InitMaterializedSRF(fcinfo, 0);
+
+#if PG14_GTE
+  parsetrees = raw_parser(query, RAW_PARSE_DEFAULT);
+#else
+  parsetrees = raw_parser(query);
+#endif
+
+  if (list_length(parsetrees) != 1)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("supautils_explain() takes a single statement")));
+
+  pstmt              = makeNode(PlannedStmt);
+  pstmt->commandType = CMD_UTILITY;
+  pstmt->canSetTag   = true;
+  pstmt->utilityStmt = linitial_node(RawStmt, parsetrees)->stmt;
+
+  INSTR_TIME_SET_CURRENT(trace.last);
+
+  handler = find_utility_handler(nodeTag(pstmt->utilityStmt));
+  trace_check(&ctx, "handler",
+              GetCommandTagName(CreateCommandTag(pstmt->utilityStmt)),
+              trace_bool(handler != NULL));
+
+  if (handler != NULL) {
+    hook_timer timer;
+
+    hook_timer_start(&timer, false);
+    pause_stats(true);
+
+    BeginInternalSubTransaction(NULL);
+    MemoryContextSwitchTo(oldcxt);
+
+    PG_TRY();
+    {
+#if PG14_GTE
+      handler(pstmt, query, false, PROCESS_UTILITY_TOPLEVEL, NULL, NULL,
+              None_Receiver, NULL, &ctx, &timer);
+#else
+      handler(pstmt, query, PROCESS_UTILITY_TOPLEVEL, NULL, NULL,
+              None_Receiver, NULL, &ctx, &timer);
+#endif
+
+      RollbackAndReleaseCurrentSubTransaction();
+      MemoryContextSwitchTo(oldcxt);
+      CurrentResourceOwner = oldowner;
+      pause_stats(false);
+    }
+    PG_CATCH();
+    {
+      ErrorData *edata;
+
+      MemoryContextSwitchTo(oldcxt);
+      edata = CopyErrorData();
+      FlushErrorState();
+
+      RollbackAndReleaseCurrentSubTransaction();
+      MemoryContextSwitchTo(oldcxt);
+      CurrentResourceOwner = oldowner;
+      pause_stats(false);
+
+      if (edata->sqlerrcode == ERRCODE_QUERY_CANCELED) ReThrowError(edata);
+
+      // the handler would raise this error
+      trace.decision = "reject";
+      rejected       = edata->message;
+    }
+    PG_END_TRY();
+  }
+
+  trace_check(&ctx, "decision", rejected,
+              trace.decision != NULL ? trace.decision : "chain");
+
+  return (Datum)0;
+}
+
 void _PG_init(void) {
 
   // process utility hook
@@ -1524,6 +2229,35 @@ void _PG_init(void) {
   prev_executor_start_hook = ExecutorStart_hook;
   ExecutorStart_hook       = supautils_executor_start;
 
+  // read before reserving the shared memory, the ring buffer is only needed
+  // when auditing
+  DefineCustomBoolVariable(
+      "supautils.audit",
+      "Write audit records for the utility statements handled by supautils",
+      NULL, &audit, false, PGC_POSTMASTER, 0, NULL, NULL, NULL);
+
+  DefineCustomStringVariable(
+      "supautils.audit_file",
+      "File the audit records are appended to, relative to the data directory",
+      NULL, &audit_file, "supautils_audit.csv", PGC_SIGHUP, 0, NULL, NULL,
+      NULL);
+
+  DefineCustomBoolVariable(
+      "supautils.extension_registry",
+      "Index the available extensions in shared memory with a background "
+      "worker",
+      NULL, &extension_registry, false, PGC_POSTMASTER, 0, NULL, NULL, NULL);
+
+  init_audit(audit);
+  init_extension_registry(extension_registry);
+  init_stats();
+  init_hook_latency();
+  init_extension_slots();
+  init_superuser_cache();
+  init_reserved_memberships();
+  init_permission_hints();
+  reserve_named_shmem();
+
   DefineCustomStringVariable("supautils.extensions_parameter_overrides",
                              "Overrides for CREATE EXTENSION parameters", NULL,
                              &extensions_parameter_overrides_str, NULL,
@@ -1534,14 +2268,21 @@ void _PG_init(void) {
   DefineCustomStringVariable(
       "supautils.reserved_roles",
       "Comma-separated list of roles that cannot be modified", NULL,
-      &reserved_roles, NULL, PGC_SIGHUP, 0, reserved_roles_check_hook, NULL,
-      NULL);
+      &reserved_roles, NULL, PGC_SIGHUP, 0, reserved_roles_check_hook,
+      dispatch_assign_hook, NULL);
 
   DefineCustomStringVariable(
       "supautils.reserved_memberships",
       "Comma-separated list of roles whose memberships cannot be granted", NULL,
       &reserved_memberships, NULL, PGC_SIGHUP, 0,
-      reserved_memberships_check_hook, NULL, NULL);
+      reserved_memberships_check_hook, reserved_memberships_assign_hook, NULL);
+
+  DefineCustomBoolVariable(
+      "supautils.transitive_reserved_memberships",
+      "Also reserve the memberships of roles that are members of "
+      "supautils.reserved_memberships",
+      NULL, &transitive_reserved_memberships, false, PGC_SUSET, 0, NULL, NULL,
+      NULL);
 
   DefineCustomStringVariable(
       "supautils.placeholders",
@@ -1555,48 +2296,80 @@ void _PG_init(void) {
       "disallowed values for the GUC placeholders defined in "
       "supautils.placeholders",
       NULL, &placeholders_disallowed_values, NULL, PGC_SIGHUP, 0,
-      placeholders_disallowed_values_check_hook, NULL, NULL);
+      placeholders_disallowed_values_check_hook,
+      placeholders_disallowed_values_assign_hook, NULL);
+
+  DefineCustomIntVariable(
+      "supautils.placeholders_max_length",
+      "Maximum length of the values of supautils.placeholders",
+      "0 means no limit", &placeholders_max_length, 0, 0, INT_MAX - 1,
+      PGC_SUSET, GUC_UNIT_BYTE, NULL, NULL, NULL);
 
   DefineCustomStringVariable("supautils.privileged_extensions",
                              "Comma-separated list of extensions which get "
                              "installed using supautils.superuser",
                              NULL, &privileged_extensions, NULL, PGC_SIGHUP, 0,
-                             privileged_extensions_check_hook, NULL, NULL);
+                             privileged_extensions_check_hook,
+                             dispatch_assign_hook, NULL);
 
   DefineCustomStringVariable(
       "supautils.privileged_extensions_custom_scripts_path",
       "Path to load privileged extensions' custom scripts from. Deprecated: "
       "use supautils.extension_custom_scripts_path instead.",
-      NULL, &extension_custom_scripts_path, NULL, PGC_SIGHUP, 0, NULL, NULL,
-      NULL);
+      NULL, &extension_custom_scripts_path, NULL, PGC_SIGHUP, 0, NULL,
+      dispatch_assign_hook, NULL);
 
   DefineCustomStringVariable("supautils.extension_custom_scripts_path",
                              "Path to load extension custom scripts from", NULL,
                              &extension_custom_scripts_path, NULL, PGC_SIGHUP,
-                             0, NULL, NULL, NULL);
+                             0, NULL, dispatch_assign_hook, NULL);
 
   DefineCustomStringVariable(
       "supautils.superuser",
       "Superuser to install extensions in supautils.privileged_extensions as",
-      NULL, &supautils_superuser, NULL, PGC_SIGHUP, 0, NULL, NULL, NULL);
+      NULL, &supautils_superuser, NULL, PGC_SIGHUP, 0, superuser_check_hook,
+      superuser_assign_hook, NULL);
 
   // TODO emit a warning when this deprecated GUC is used
   DefineCustomStringVariable(
       "supautils.privileged_extensions_superuser",
       "Superuser to install extensions in supautils.privileged_extensions "
       "as. Deprecated: use supautils.superuser instead.",
-      NULL, &supautils_superuser, NULL, PGC_SIGHUP, 0, NULL, NULL, NULL);
+      NULL, &supautils_superuser, NULL, PGC_SIGHUP, 0, superuser_check_hook,
+      superuser_assign_hook, NULL);
+
+  DefineCustomIntVariable(
+      "supautils.escalated_lock_timeout",
+      "lock_timeout applied to the statements run as supautils.superuser",
+      "0 keeps the session lock_timeout", &escalated_lock_timeout, 0, 0,
+      INT_MAX, PGC_SIGHUP, GUC_UNIT_MS, NULL,
+      escalated_lock_timeout_assign_hook, NULL);
 
   DefineCustomStringVariable(
       "supautils.privileged_role",
       "Non-superuser role to be granted with some superuser privileges", NULL,
-      &privileged_role, NULL, PGC_SIGHUP, 0, NULL, NULL, NULL);
+      &privileged_role, NULL, PGC_SIGHUP, 0, NULL, dispatch_assign_hook,
+      NULL);
 
   DefineCustomStringVariable(
       "supautils.privileged_role_allowed_configs",
       "Superuser-only configs that the privileged_role is allowed to configure",
       NULL, &privileged_role_allowed_configs, NULL, PGC_SIGHUP, 0,
-      privileged_role_allowed_configs_check_hook, NULL, NULL);
+      privileged_role_allowed_configs_check_hook, dispatch_assign_hook, NULL);
+
+  DefineCustomStringVariable(
+      "supautils.privileged_role_config_ceilings",
+      "Maximum values of the configs the privileged_role is allowed to "
+      "configure",
+      NULL, &config_ceilings_str, NULL, PGC_SIGHUP, 0,
+      config_ceilings_check_hook, config_ceilings_assign_hook, NULL);
+
+  DefineCustomEnumVariable(
+      "supautils.privileged_role_config_ceilings_mode",
+      "What to do with values above supautils.privileged_role_config_ceilings",
+      "error: reject the statement; clamp: use the ceiling with a warning",
+      &config_ceilings_mode, CONFIG_CEILINGS_ERROR,
+      config_ceilings_mode_options, PGC_SUSET, 0, NULL, NULL, NULL);
 
   DefineCustomStringVariable(
       "supautils.hint_roles",
@@ -1611,15 +2384,31 @@ void _PG_init(void) {
                              PGC_SIGHUP, 0, constrained_extensions_check_hook,
                              constrained_extensions_assign_hook, NULL);
 
+  DefineCustomIntVariable(
+      "supautils.constrained_extensions_max_concurrency",
+      "Maximum number of statements running at once on all the "
+      "supautils.constrained_extensions",
+      "0 means no limit", &constrained_extensions_max_concurrency, 0, 0,
+      MAX_BACKENDS, PGC_SIGHUP, 0, NULL, NULL, NULL);
+
+  DefineCustomIntVariable(
+      "supautils.constrained_extensions_concurrency_timeout",
+      "Time to wait for a supautils.constrained_extensions concurrency slot",
+      "0 fails right away, -1 waits forever",
+      &constrained_extensions_concurrency_timeout, 0, -1, INT_MAX, PGC_SIGHUP,
+      GUC_UNIT_MS, NULL, NULL, NULL);
+
   DefineCustomStringVariable("supautils.drop_trigger_grants",
                              "Allow non-owners to drop triggers on tables",
                              NULL, &drop_trigger_grants_str, NULL, PGC_SIGHUP,
-                             0, &drop_trigger_grants_check_hook, NULL, NULL);
+                             0, &drop_trigger_grants_check_hook,
+                             dispatch_assign_hook, NULL);
 
   DefineCustomStringVariable("supautils.policy_grants",
                              "Allow non-owners to manage policies on tables",
                              NULL, &policy_grants_str, NULL, PGC_SIGHUP, 0,
-                             &policy_grants_check_hook, NULL, NULL);
+                             &policy_grants_check_hook, dispatch_assign_hook,
+                             NULL);
 
   DefineCustomEnumVariable(
       "supautils.restrict_extension_versions",
@@ -1627,13 +2416,48 @@ void _PG_init(void) {
       "off: no restriction; warn: ignore the specified version with a warning "
       "and use the default version; error: reject the statement",
       &restrict_extension_versions, RESTRICT_EXTENSION_VERSIONS_OFF,
-      restrict_extension_versions_options, PGC_SUSET, 0, NULL, NULL, NULL);
+      restrict_extension_versions_options, PGC_SUSET, 0, NULL,
+      dispatch_enum_assign_hook, NULL);
+
+  DefineCustomEnumVariable(
+      "supautils.ddl_guard",
+      "Restrict the DDL that blocks writes on large relations to superusers",
+      "off: no restriction; warn: run the statement with a warning; error: "
+      "reject the statement",
+      &ddl_guard, DDL_GUARD_OFF, ddl_guard_options, PGC_SUSET, 0, NULL,
+      dispatch_enum_assign_hook, NULL);
+
+  DefineCustomIntVariable(
+      "supautils.ddl_guard_size",
+      "Relation size above which supautils.ddl_guard applies", NULL,
+      &ddl_guard_size, (1024 * 1024 * 1024) / BLCKSZ, 0, INT_MAX, PGC_SUSET,
+      GUC_UNIT_BLOCKS, NULL, NULL, NULL);
 
   DefineCustomBoolVariable("supautils.log_skipped_evtrigs",
                            "Log skipped event triggers with a NOTICE level",
                            NULL, &log_skipped_evtrigs, false, PGC_USERSET, 0,
                            NULL, NULL, NULL);
 
+  DefineCustomBoolVariable(
+      "supautils.track_hook_latency",
+      "Record the time spent in supautils hooks into latency histograms", NULL,
+      &track_hook_latency, false, PGC_SUSET, 0, NULL, NULL, NULL);
+
+  DefineCustomStringVariable(
+      "supautils.executor_start_bypass_processes",
+      "Process types on which the ExecutorStart hook does nothing", NULL,
+      &executor_start_bypass_processes_str,
+      "parallel_worker, autovacuum, walsender, background_worker", PGC_SIGHUP,
+      0, executor_start_bypass_processes_check_hook,
+      executor_start_bypass_processes_assign_hook, NULL);
+
+  DefineCustomStringVariable(
+      "supautils.fmgr_bypass_processes",
+      "Process types on which the fmgr hooks do nothing", NULL,
+      &fmgr_bypass_processes_str, "parallel_worker, autovacuum", PGC_SIGHUP, 0,
+      fmgr_bypass_processes_check_hook, fmgr_bypass_processes_assign_hook,
+      NULL);
+
   // DO NOT USE; here for backward compat
   DefineCustomBoolVariable("supautils.disable_program", NULL, NULL,
                            &disable_program, false, PGC_SIGHUP,
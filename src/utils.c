@@ -1,5 +1,8 @@
 #include "pg_prelude.h"
 
+#include "explain.h"
+#include "probes.h"
+#include "stats.h"
 #include "utils.h"
 
 static Oid prev_role_oid         = 0;
@@ -8,32 +11,193 @@ static int prev_role_sec_context = 0;
 // Prevent nested switch_to_superuser() calls from corrupting prev_role_*
 static bool is_switched_to_superuser = false;
 
+// the role of the last switch_to_superuser(), for the audit records
+static Oid escalated_role = InvalidOid;
+
+// supautils.escalated_lock_timeout, and the one applied to the current
+// escalation (0 when the session has a lower lock_timeout)
+static int escalated_lock_timeout  = 0;
+static int applied_lock_timeout    = 0;
+static int lock_timeout_nest_level = 0;
+
+// supautils.superuser resolved once per reload, role changes invalidate it
+static Oid  superuser_oid       = InvalidOid;
+static bool superuser_oid_stale = true;
+
 static bool strstarts(const char *str, const char *prefix) {
   return strncmp(str, prefix, strlen(prefix)) == 0;
 }
 
+static void
+superuser_oid_syscache_callback(__attribute__((unused)) Datum  arg,
+                                __attribute__((unused)) int    cacheid,
+                                __attribute__((unused)) uint32 hashvalue) {
+  superuser_oid_stale = true;
+}
+
+void init_superuser_cache(void) {
+  CacheRegisterSyscacheCallback(AUTHOID, superuser_oid_syscache_callback,
+                                (Datum)0);
+}
+
+void invalidate_superuser_oid(void) { superuser_oid_stale = true; }
+
+Oid check_superuser(const char *supauser, int elevel) {
+  Oid role_oid = get_role_oid(supauser, true);
+
+  if (!OidIsValid(role_oid))
+    ereport(elevel,
+            (errcode(ERRCODE_UNDEFINED_OBJECT),
+             errmsg("supautils.superuser role \"%s\" does not exist",
+                    supauser),
+             errhint("Statements that switch to supautils.superuser will "
+                     "fail until the role is created.")));
+
+  return role_oid;
+}
+
+void validate_superuser(const char *supauser) {
+  if (supauser == NULL || !superuser_oid_stale || !IsTransactionState())
+    return;
+
+  // any session can get here after a reload, so it only goes to the log
+  superuser_oid       = check_superuser(supauser, LOG);
+  superuser_oid_stale = !OidIsValid(superuser_oid);
+}
+
+static Oid get_superuser_oid(const char *supauser) {
+  if (supauser == NULL) return BOOTSTRAP_SUPERUSERID;
+
+  if (superuser_oid_stale) {
+    superuser_oid       = get_role_oid(supauser, false);
+    superuser_oid_stale = false;
+  }
+
+  return superuser_oid;
+}
+
+void set_escalated_lock_timeout(int timeout_ms) {
+  escalated_lock_timeout = timeout_ms;
+}
+
+// Lower lock_timeout for the escalated statement, in its own GUC nest level so
+// switch_to_original_role() can restore the session value. On error the
+// transaction abort restores it.
+static void apply_escalated_lock_timeout(void) {
+  applied_lock_timeout = 0;
+
+  if (escalated_lock_timeout == 0 ||
+      (LockTimeout > 0 && LockTimeout <= escalated_lock_timeout))
+    return;
+
+  lock_timeout_nest_level = NewGUCNestLevel();
+  applied_lock_timeout    = escalated_lock_timeout;
+
+  (void)set_config_option("lock_timeout",
+                          psprintf("%d", escalated_lock_timeout), PGC_SUSET,
+                          PGC_S_SESSION, GUC_ACTION_SAVE, true, 0, false);
+}
+
 void switch_to_superuser(const char *supauser, bool *already_switched) {
-  Oid superuser_oid = BOOTSTRAP_SUPERUSERID;
+  Oid target_oid;
+
   *already_switched = is_switched_to_superuser;
 
   if (*already_switched) {
     return;
   }
+
+  target_oid = get_superuser_oid(supauser);
+
   is_switched_to_superuser = true;
+  escalated_role           = target_oid;
 
-  if (supauser != NULL) {
-    superuser_oid = get_role_oid(supauser, false);
-  }
+  apply_escalated_lock_timeout();
 
   GetUserIdAndSecContext(&prev_role_oid, &prev_role_sec_context);
-  SetUserIdAndSecContext(superuser_oid, prev_role_sec_context |
-                                            SECURITY_LOCAL_USERID_CHANGE |
-                                            SECURITY_RESTRICTED_OPERATION);
+  SetUserIdAndSecContext(target_oid, prev_role_sec_context |
+                                         SECURITY_LOCAL_USERID_CHANGE |
+                                         SECURITY_RESTRICTED_OPERATION);
+
+  stats_incr(STAT_SUPERUSER_ESCALATED);
+  TRACE_SUPAUTILS_SUPERUSER_SWITCH(prev_role_oid, target_oid);
 }
 
 void switch_to_original_role(void) {
   SetUserIdAndSecContext(prev_role_oid, prev_role_sec_context);
   is_switched_to_superuser = false;
+
+  if (lock_timeout_nest_level > 0) {
+    AtEOXact_GUC(true, lock_timeout_nest_level);
+    lock_timeout_nest_level = 0;
+  }
+  TRACE_SUPAUTILS_SUPERUSER_RESTORE(prev_role_oid);
+}
+
+void rethrow_escalated_error(void) {
+  int           timeout = applied_lock_timeout;
+  MemoryContext old_context;
+  ErrorData    *edata;
+
+  if (timeout == 0) PG_RE_THROW();
+
+  // CopyErrorData() can't run in the ErrorContext
+  old_context = MemoryContextSwitchTo(CurTransactionContext);
+  edata       = CopyErrorData();
+  MemoryContextSwitchTo(old_context);
+
+  // ProcessInterrupts() clears the LOCK_TIMEOUT indicator before it raises the
+  // error, so the timeout is told apart from NOWAIT and the conditional locks,
+  // that have the same code, by where it's raised
+  if (edata->sqlerrcode != ERRCODE_LOCK_NOT_AVAILABLE ||
+      edata->funcname == NULL ||
+      strcmp(edata->funcname, "ProcessInterrupts") != 0) {
+    FreeErrorData(edata);
+    PG_RE_THROW();
+  }
+
+  // the enclosing escalations re-throw this one as is
+  applied_lock_timeout = 0;
+
+  FlushErrorState();
+  stats_incr(STAT_ESCALATED_LOCK_TIMEOUT);
+  ereport(ERROR,
+          (errcode(ERRCODE_LOCK_NOT_AVAILABLE),
+           errmsg(
+               "canceling statement due to supautils.escalated_lock_timeout"),
+           errdetail("The statement waited more than %d ms for a lock while "
+                     "running as supautils.superuser: %s.",
+                     timeout, edata->message),
+           errhint("Retry once the conflicting queries are done.")));
+}
+
+Oid take_escalated_role(void) {
+  Oid role = escalated_role;
+
+  escalated_role = InvalidOid;
+
+  return role;
+}
+
+const char *stmt_role_name(stmt_context *ctx) {
+  if (ctx->role_name == NULL)
+    ctx->role_name = GetUserNameFromId(ctx->role_oid, false);
+
+  return ctx->role_name;
+}
+
+bool stmt_role_is_superuser(stmt_context *ctx) {
+  if (!ctx->superuser_checked) {
+    ctx->is_superuser      = superuser_arg(ctx->role_oid);
+    ctx->superuser_checked = true;
+
+    // the role name is only looked up for the trace
+    if (stmt_is_explained(ctx))
+      trace_check(ctx, "superuser", stmt_role_name(ctx),
+                  trace_bool(ctx->is_superuser));
+  }
+
+  return ctx->is_superuser;
 }
 
 bool is_string_in_comma_delimited_string(const char *s1, const char *s2) {
@@ -80,47 +244,97 @@ bool remove_ending_wildcard(char *elem) {
   return wildcard_removed;
 }
 
-static void alter_role_super(const char *rolename, bool make_super) {
-  RoleSpec *rolespec = makeNode(RoleSpec);
-  rolespec->roletype = ROLESPEC_CSTRING;
-  rolespec->rolename = pstrdup(rolename);
-  rolespec->location = -1;
+// Event triggers and foreign data wrappers can only be owned by superusers, the
+// owner is changed directly on the catalog to skip that check. Toggling
+// SUPERUSER on the new owner instead would update pg_authid twice and
+// invalidate the role caches of every backend.
+static void set_event_trigger_owner(const char *name, Oid new_owner) {
+  Relation              rel;
+  HeapTuple             tup;
+  Form_pg_event_trigger form;
 
-  AlterRoleStmt *alter_stmt = makeNode(AlterRoleStmt);
-  alter_stmt->role          = rolespec;
+  rel = table_open(EventTriggerRelationId, RowExclusiveLock);
+  tup = SearchSysCacheCopy1(EVENTTRIGGERNAME, CStringGetDatum(name));
 
-#if PG15_GTE
-  alter_stmt->options =
-      list_make1(makeDefElem("superuser", (Node *)makeBoolean(make_super), -1));
+  if (!HeapTupleIsValid(tup))
+    ereport(ERROR, (errcode(ERRCODE_UNDEFINED_OBJECT),
+                    errmsg("event trigger \"%s\" does not exist", name)));
 
-  AlterRole(NULL, alter_stmt);
-#else
-  alter_stmt->options =
-      list_make1(makeDefElem("superuser", (Node *)makeInteger(make_super), -1));
+  form = (Form_pg_event_trigger)GETSTRUCT(tup);
 
-  AlterRole(alter_stmt);
-#endif
+  if (form->evtowner != new_owner) {
+    form->evtowner = new_owner;
 
-  CommandCounterIncrement();
+    CatalogTupleUpdate(rel, &tup->t_self, tup);
+    changeDependencyOnOwner(EventTriggerRelationId, form->oid, new_owner);
+    InvokeObjectPostAlterHook(EventTriggerRelationId, form->oid, 0);
+  }
+
+  heap_freetuple(tup);
+  table_close(rel, RowExclusiveLock);
+}
+
+static void set_fdw_owner(const char *name, Oid new_owner) {
+  Relation                     rel;
+  HeapTuple                    tup;
+  Form_pg_foreign_data_wrapper form;
+
+  rel = table_open(ForeignDataWrapperRelationId, RowExclusiveLock);
+  tup = SearchSysCacheCopy1(FOREIGNDATAWRAPPERNAME, CStringGetDatum(name));
+
+  if (!HeapTupleIsValid(tup))
+    ereport(ERROR,
+            (errcode(ERRCODE_UNDEFINED_OBJECT),
+             errmsg("foreign-data wrapper \"%s\" does not exist", name)));
+
+  form = (Form_pg_foreign_data_wrapper)GETSTRUCT(tup);
+
+  if (form->fdwowner != new_owner) {
+    Datum     repl_val[Natts_pg_foreign_data_wrapper]  = {0};
+    bool      repl_null[Natts_pg_foreign_data_wrapper] = {0};
+    bool      repl_repl[Natts_pg_foreign_data_wrapper] = {0};
+    const Oid fdw_oid                                  = form->oid;
+    bool      acl_is_null;
+    Datum     acl_datum;
+    HeapTuple new_tup;
+
+    repl_repl[Anum_pg_foreign_data_wrapper_fdwowner - 1] = true;
+    repl_val[Anum_pg_foreign_data_wrapper_fdwowner - 1] =
+        ObjectIdGetDatum(new_owner);
+
+    // the existing grants are transferred to the new owner
+    acl_datum = heap_getattr(tup, Anum_pg_foreign_data_wrapper_fdwacl,
+                             RelationGetDescr(rel), &acl_is_null);
+    if (!acl_is_null) {
+      repl_repl[Anum_pg_foreign_data_wrapper_fdwacl - 1] = true;
+      repl_val[Anum_pg_foreign_data_wrapper_fdwacl - 1]  = PointerGetDatum(
+          aclnewowner(DatumGetAclP(acl_datum), form->fdwowner, new_owner));
+    }
+
+    new_tup = heap_modify_tuple(tup, RelationGetDescr(rel), repl_val,
+                                repl_null, repl_repl);
+
+    CatalogTupleUpdate(rel, &new_tup->t_self, new_tup);
+    changeDependencyOnOwner(ForeignDataWrapperRelationId, fdw_oid, new_owner);
+    InvokeObjectPostAlterHook(ForeignDataWrapperRelationId, fdw_oid, 0);
+
+    heap_freetuple(new_tup);
+  }
+
+  heap_freetuple(tup);
+  table_close(rel, RowExclusiveLock);
 }
 
 // Changes the OWNER of a database object.
-// Some objects (e.g. foreign data wrappers) can only be owned by superusers, so
-// this switches to superuser accordingly and then goes backs to non-super.
 void alter_owner(const char *obj_name, Oid role_oid,
                  altered_obj_type obj_type) {
   switch (obj_type) {
-  case ALT_FDW: {
-    char *role_name = GetUserNameFromId(role_oid, false);
-    alter_role_super(role_name, true);
+  case ALT_FDW:
 
-    AlterForeignDataWrapperOwner(obj_name, role_oid);
+    set_fdw_owner(obj_name, role_oid);
     CommandCounterIncrement();
 
-    alter_role_super(role_name, false);
-
     break;
-  }
 
   case ALT_PUB:
 
@@ -129,19 +343,13 @@ void alter_owner(const char *obj_name, Oid role_oid,
 
     break;
 
-  case ALT_EVTRIG: {
-    char *role_name = GetUserNameFromId(role_oid, false);
+  case ALT_EVTRIG:
 
-    alter_role_super(role_name, true);
-
-    AlterEventTriggerOwner(obj_name, role_oid);
+    set_event_trigger_owner(obj_name, role_oid);
     CommandCounterIncrement();
 
-    alter_role_super(role_name, false);
-
     break;
   }
-  }
 }
 
 #if PG17_LT
@@ -153,3 +361,35 @@ void destroyStringInfo(StringInfo str) {
   pfree(str);
 }
 #endif
+
+#if PG15_LT
+// Polyfill for pg < 15
+// https://github.com/postgres/postgres/blob/REL_15_0/src/backend/utils/fmgr/funcapi.c#L76-L129
+void InitMaterializedSRF(FunctionCallInfo                fcinfo,
+                         __attribute__((unused)) bits32 flags) {
+  ReturnSetInfo *rsinfo = (ReturnSetInfo *)fcinfo->resultinfo;
+  MemoryContext  oldcontext;
+  TupleDesc      tupdesc;
+
+  if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+    ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                    errmsg("set-valued function called in context that cannot "
+                           "accept a set")));
+  if (!(rsinfo->allowedModes & SFRM_Materialize))
+    ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                    errmsg("materialize mode required, but it is not allowed "
+                           "in this context")));
+
+  oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+  if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+    elog(ERROR, "return type must be a row type");
+
+  rsinfo->returnMode = SFRM_Materialize;
+  rsinfo->setResult  = tuplestore_begin_heap(
+      rsinfo->allowedModes & SFRM_Materialize_Random, false, work_mem);
+  rsinfo->setDesc = CreateTupleDescCopy(tupdesc);
+
+  MemoryContextSwitchTo(oldcontext);
+}
+#endif
@@ -5,6 +5,7 @@
 
 #include <catalog/pg_authid.h>
 #include <commands/user.h>
+#include <fmgr.h>
 #include <miscadmin.h>
 #include <nodes/params.h>
 #include <tcop/dest.h>
@@ -12,6 +13,36 @@
 #include <utils/acl.h>
 #include <utils/queryenvironment.h>
 
+/**
+ * Register the invalidation of the cached supautils.superuser Oid. Must be
+ * called from _PG_init().
+ */
+extern void init_superuser_cache(void);
+
+/**
+ * Forget the cached supautils.superuser Oid, it's resolved again on the next
+ * switch_to_superuser().
+ */
+extern void invalidate_superuser_oid(void);
+
+/**
+ * Look up a supautils.superuser role, reporting at `elevel` when it doesn't
+ * exist. Must be called inside a transaction.
+ */
+extern Oid check_superuser(const char *superuser, int elevel);
+
+/**
+ * Resolve the supautils.superuser Oid ahead of the first switch so a missing
+ * role is logged early. Does nothing outside of a transaction.
+ */
+extern void validate_superuser(const char *superuser);
+
+/**
+ * The lock_timeout applied while switched to a superuser, 0 to keep the
+ * session's.
+ */
+extern void set_escalated_lock_timeout(int timeout_ms);
+
 /**
  * Switch to a superuser and save the original role. Caller is responsible for
  * calling switch_to_original_role() afterwards.
@@ -24,6 +55,18 @@ extern void switch_to_superuser(const char *superuser, bool *already_switched);
  */
 extern void switch_to_original_role(void);
 
+/**
+ * Re-throw the error caught while switched to a superuser, reporting a lock
+ * timeout caused by supautils.escalated_lock_timeout with its own message.
+ */
+extern void rethrow_escalated_error(void);
+
+/**
+ * Returns the role of the last switch_to_superuser() and forgets it,
+ * InvalidOid if there was no switch since the previous call.
+ */
+extern Oid take_escalated_role(void);
+
 /**
  * Returns `false` if either s1 or s2 is NULL.
  */
@@ -31,6 +74,29 @@ extern bool is_string_in_comma_delimited_string(const char *s1, const char *s2);
 
 extern bool remove_ending_wildcard(char *);
 
+typedef struct explain_trace explain_trace;
+
+/**
+ * The role running a utility statement. Its name and attributes are looked up
+ * lazily, at most once per statement.
+ */
+typedef struct {
+  Oid            role_oid;
+  char          *role_name;
+  bool           superuser_checked;
+  bool           is_superuser;
+  bool           privileged_checked;
+  bool           is_privileged;
+  explain_trace *trace; // NULL unless the statement is explained, see explain.h
+} stmt_context;
+
+// an explained statement is only checked, nothing is run
+#define stmt_is_explained(ctx) ((ctx)->trace != NULL)
+
+extern const char *stmt_role_name(stmt_context *ctx);
+
+extern bool stmt_role_is_superuser(stmt_context *ctx);
+
 typedef enum { ALT_FDW, ALT_PUB, ALT_EVTRIG } altered_obj_type;
 
 extern void alter_owner(const char *obj_name, Oid role_oid,
@@ -38,4 +104,8 @@ extern void alter_owner(const char *obj_name, Oid role_oid,
 
 extern void destroyStringInfo(StringInfo str);
 
+#if PG_VERSION_NUM < 150000
+extern void InitMaterializedSRF(FunctionCallInfo fcinfo, bits32 flags);
+#endif
+
 #endif
@@ -0,0 +1,42 @@
+#include "pg_prelude.h"
+
+#include "wait_events.h"
+
+#if PG17_GTE
+
+// names for every supautils_wait_event, in the same order
+static const char *const wait_event_names[WAIT_EVENT_COUNT] = {
+  "SupautilsSystemResources",
+  "SupautilsExtensionSlot",
+};
+
+static uint32 wait_event_ids[WAIT_EVENT_COUNT] = {0};
+static bool   wait_events_registered           = false;
+
+// Registering is idempotent across backends, the ids are looked up by name.
+// All the events are registered at once so they're listed together in
+// pg_wait_events.
+static void register_wait_events(void) {
+  for (int i = 0; i < WAIT_EVENT_COUNT; i++)
+    wait_event_ids[i] = WaitEventExtensionNew(wait_event_names[i]);
+
+  wait_events_registered = true;
+}
+
+#endif
+
+// event is unused on pg < 17
+uint32
+supautils_wait_event_info(__attribute__((unused)) supautils_wait_event event) {
+#if PG17_GTE
+  if (!wait_events_registered) register_wait_events();
+
+  return wait_event_ids[event];
+#else
+  return PG_WAIT_EXTENSION;
+#endif
+}
+
+void supautils_wait_start(supautils_wait_event event) {
+  pgstat_report_wait_start(supautils_wait_event_info(event));
+}
@@ -0,0 +1,25 @@
+#ifndef WAIT_EVENTS_H
+#define WAIT_EVENTS_H
+
+#include "pg_prelude.h"
+
+typedef enum {
+  WAIT_EVENT_SYSTEM_RESOURCES,
+  WAIT_EVENT_EXTENSION_SLOT,
+  WAIT_EVENT_COUNT
+} supautils_wait_event;
+
+/**
+ * Report a supautils wait event in pg_stat_activity, until
+ * pgstat_report_wait_end() is called. On pg < 17 the generic "Extension" wait
+ * event is reported instead.
+ */
+extern void supautils_wait_start(supautils_wait_event event);
+
+/**
+ * The wait_event_info of a supautils wait event, for the functions that
+ * report it themselves, e.g. ConditionVariableTimedSleep().
+ */
+extern uint32 supautils_wait_event_info(supautils_wait_event event);
+
+#endif
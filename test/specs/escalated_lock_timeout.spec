@@ -0,0 +1,40 @@
+# supautils.escalated_lock_timeout (set in init.conf) cancels the lock waits of
+# the statements run as supautils.superuser. Other lock errors raised while
+# escalated are left as they are, like the one of a NOWAIT in an event trigger.
+
+setup
+{
+  CREATE TABLE escalated_lock_target();
+  CREATE FUNCTION lock_target_nowait() RETURNS event_trigger
+  LANGUAGE plpgsql SECURITY DEFINER AS $$
+  BEGIN
+    LOCK TABLE escalated_lock_target IN ACCESS SHARE MODE NOWAIT;
+  END $$;
+  CREATE EVENT TRIGGER lock_target_nowait ON ddl_command_end
+  WHEN TAG IN ('COMMENT') EXECUTE FUNCTION lock_target_nowait();
+}
+
+teardown
+{
+  DROP EVENT TRIGGER lock_target_nowait;
+  DROP FUNCTION lock_target_nowait();
+  DROP TABLE escalated_lock_target;
+}
+
+session holder
+setup		{ BEGIN; }
+step hold_extension	{ COMMENT ON EXTENSION plpgsql IS 'held'; }
+step hold_table	{ LOCK TABLE escalated_lock_target; }
+teardown	{ ROLLBACK; }
+
+session escalated
+setup		{ SET ROLE privileged_role; }
+step comment	{ COMMENT ON EXTENSION plpgsql IS 'escalated'; }
+step comment_timeout	{ DO $$ DECLARE detail text; BEGIN COMMENT ON EXTENSION plpgsql IS 'escalated'; EXCEPTION WHEN lock_not_available THEN GET STACKED DIAGNOSTICS detail = PG_EXCEPTION_DETAIL; RAISE NOTICE '%: %', SQLERRM, detail; END $$; }
+teardown	{ RESET ROLE; }
+
+# the lock wait is canceled, the original error is kept in the detail
+permutation hold_extension comment_timeout(*)
+
+# NOWAIT doesn't wait for the timeout
+permutation hold_table comment
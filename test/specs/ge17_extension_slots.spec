@@ -0,0 +1,36 @@
+# tcn is limited to one statement at a time (set in init.conf). The slot is
+# held by a CREATE EXTENSION that waits for an uncommitted one of another
+# session, the extension slots need shared memory, which the DSM registry gives
+# on pg >= 17 without shared_preload_libraries.
+
+teardown
+{
+  DROP EXTENSION IF EXISTS tcn;
+  DO $$ BEGIN PERFORM pg_reload_conf(); END $$;
+}
+
+session locker
+setup		{ BEGIN; }
+step lock	{ CREATE EXTENSION tcn; }
+step unlock	{ ROLLBACK; }
+
+session holder
+step hold	{ CREATE EXTENSION IF NOT EXISTS tcn; }
+step hold_briefly	{ SET lock_timeout = '500ms'; CREATE EXTENSION IF NOT EXISTS tcn; }
+
+session waiter
+step timeout_0	{ ALTER SYSTEM SET supautils.constrained_extensions_concurrency_timeout TO 0; }
+step timeout_100	{ ALTER SYSTEM SET supautils.constrained_extensions_concurrency_timeout TO 100; }
+step timeout_forever	{ ALTER SYSTEM SET supautils.constrained_extensions_concurrency_timeout TO -1; }
+step reload	{ DO $$ BEGIN PERFORM pg_reload_conf(); END $$; }
+step create_ext	{ DO $$ DECLARE detail text; BEGIN CREATE EXTENSION IF NOT EXISTS tcn; EXCEPTION WHEN configuration_limit_exceeded THEN GET STACKED DIAGNOSTICS detail = PG_EXCEPTION_DETAIL; RAISE EXCEPTION '%, waited for the timeout: %', SQLERRM, substring(detail from '\d+')::int >= 100; END $$; }
+teardown	{ ALTER SYSTEM RESET supautils.constrained_extensions_concurrency_timeout; }
+
+# rejected right away
+permutation timeout_0 reload lock hold create_ext unlock
+
+# rejected once the timeout is over
+permutation timeout_100 reload lock hold create_ext unlock
+
+# waits until the slot is released, here by the lock timeout of the holder
+permutation timeout_forever reload lock hold_briefly create_ext unlock
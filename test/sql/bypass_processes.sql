@@ -0,0 +1,9 @@
+show supautils.executor_start_bypass_processes;
+show supautils.fmgr_bypass_processes;
+
+-- unknown process types are rejected
+alter system set supautils.executor_start_bypass_processes = 'parallel_worker, checkpointer';
+\echo
+
+-- event triggers can fire on walsenders and background workers
+alter system set supautils.fmgr_bypass_processes = 'parallel_worker, background_worker';
@@ -0,0 +1,41 @@
+set role privileged_role;
+\echo
+
+-- values up to the ceiling are allowed
+set temp_file_limit to '512MB';
+show temp_file_limit;
+set temp_file_limit to '1GB';
+\echo
+
+-- values above the ceiling are rejected, negative values mean no limit
+set temp_file_limit to '2GB';
+set temp_file_limit to -1;
+alter role privileged_role set temp_file_limit to '2GB';
+show temp_file_limit;
+\echo
+
+-- or clamped to the ceiling
+reset role;
+set supautils.privileged_role_config_ceilings_mode to clamp;
+set role privileged_role;
+set temp_file_limit to '2GB';
+show temp_file_limit;
+\echo
+
+-- the clamped value is not kept in a cached statement
+reset role;
+create function set_temp_file_limit() returns void language plpgsql as $$
+begin
+  set temp_file_limit to '2GB';
+end $$;
+set role privileged_role;
+select set_temp_file_limit();
+reset role;
+reset supautils.privileged_role_config_ceilings_mode;
+set role privileged_role;
+select set_temp_file_limit();
+\echo
+
+reset role;
+drop function set_temp_file_limit();
+reset temp_file_limit;
@@ -0,0 +1,18 @@
+-- the JSON configs are rejected past their maximum number of entries
+select
+  json_object_agg('ext_' || g, json_build_object('cpu', 1)) as cexts,
+  json_object_agg('ext_' || g, json_build_object('schema', 'public')) as epos,
+  json_object_agg('config_' || g, '1'::text) as ceilings,
+  json_object_agg('role_' || g, json_build_array('public.t')) as roles,
+  json_build_object('role', json_agg('public.t_' || g)) as tables
+from generate_series(1, 101) g \gset
+alter system set supautils.constrained_extensions to :'cexts';
+alter system set supautils.extensions_parameter_overrides to :'epos';
+alter system set supautils.privileged_role_config_ceilings to :'ceilings';
+alter system set supautils.policy_grants to :'roles';
+alter system set supautils.drop_trigger_grants to :'roles';
+\echo
+
+-- and so are the grants past their maximum number of tables for a role
+alter system set supautils.policy_grants to :'tables';
+alter system set supautils.drop_trigger_grants to :'tables';
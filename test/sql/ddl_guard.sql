@@ -0,0 +1,60 @@
+\set VERBOSITY terse
+set supautils.ddl_guard to error;
+set supautils.ddl_guard_size to '16kB';
+set role privileged_role;
+create table guarded as select g from generate_series(1, 10000) g;
+create table unguarded(id int);
+\echo
+
+-- rewriting alters and blocking index builds are rejected on large tables,
+-- with a hint when the index can be built concurrently first
+alter table guarded alter column g type bigint;
+alter table guarded add column r float default random();
+alter table guarded add column i int generated always as identity;
+create index on guarded (g);
+reindex table guarded;
+alter table guarded add constraint guarded_g_key unique (g);
+alter table guarded add column k int unique;
+\set VERBOSITY default
+alter table guarded add primary key (g);
+\set VERBOSITY terse
+\echo
+
+-- the ones that don't rewrite or block writes are allowed
+alter table guarded add column c int default 0;
+alter table guarded add column t text default 'x'::text;
+create index concurrently guarded_g_idx on guarded (g);
+reindex table concurrently guarded;
+reindex index concurrently guarded_g_idx;
+create unique index concurrently guarded_g_key on guarded (g);
+alter table guarded add constraint guarded_g_key unique using index guarded_g_key;
+\echo
+
+-- a small index is guarded by the size of its table, which is scanned
+create index concurrently guarded_empty_idx on guarded (g) where g < 0;
+reindex index guarded_empty_idx;
+\echo
+
+-- and so is everything on small tables
+alter table unguarded alter column id type bigint;
+create index on unguarded (id);
+reindex table unguarded;
+\echo
+
+-- warn only runs the statement with a warning
+reset role;
+set supautils.ddl_guard to warn;
+set role privileged_role;
+reindex index guarded_g_idx;
+\echo
+
+-- superusers are not guarded
+reset role;
+set supautils.ddl_guard to error;
+alter table guarded alter column g type bigint;
+\echo
+
+drop table guarded, unguarded;
+reset supautils.ddl_guard;
+reset supautils.ddl_guard_size;
+\set VERBOSITY default
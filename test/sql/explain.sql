@@ -0,0 +1,50 @@
+create or replace function supautils_explain(statement text, out step text, out object text, out result text, out duration_ns bigint)
+returns setof record as 'supautils', 'supautils_explain' language c;
+set supautils.ddl_guard to error;
+set supautils.ddl_guard_size to '16kB';
+\echo
+
+-- statements supautils doesn't handle are chained
+select step, object, result from supautils_explain('create table explain_t()');
+
+set role privileged_role;
+create table explain_guarded as select g from generate_series(1, 10000) g;
+\echo
+
+-- reserved roles are rejected
+select step, object, result from supautils_explain('alter role anon nologin');
+
+-- privileged extensions are escalated, nothing is run
+select step, object, result from supautils_explain('create extension autoinc');
+select count(*) from pg_extension where extname = 'autoinc';
+
+-- the custom scripts of other extensions are escalated too
+select step, object, result from supautils_explain('create extension fuzzystrmatch');
+select count(*) from pg_class where relname = 't1';
+
+-- allowed configs are escalated
+select step, object, result from supautils_explain('set session_replication_role to replica');
+
+-- the ddl guard reports the size of the statements it guards
+select step, object, result from supautils_explain('alter table explain_guarded alter column g type bigint');
+select step, object, result from supautils_explain('alter table explain_guarded add column c int');
+select step, object, result from supautils_explain('create index concurrently on explain_guarded (g)');
+
+set role postgres;
+\echo
+
+-- superusers are left to postgres
+select step, object, result from supautils_explain('alter role anon nologin');
+
+-- unless a handler runs for them
+create function explain_evtrig_fn() returns event_trigger language plpgsql as $$ begin end $$;
+select step, object, result from supautils_explain('create event trigger explain_evtrig on ddl_command_end execute procedure explain_evtrig_fn()');
+drop function explain_evtrig_fn();
+
+-- only one statement at a time
+select step from supautils_explain('reset role; reset role');
+
+drop table explain_guarded;
+reset supautils.ddl_guard;
+reset supautils.ddl_guard_size;
+reset role;
@@ -0,0 +1,6 @@
+-- the wait events are registered on first use
+create extension hstore;
+drop extension hstore;
+\echo
+
+select type, name from pg_wait_events where name like 'Supautils%' order by name;
@@ -0,0 +1,21 @@
+create or replace function supautils_hook_latency(out hook text, out node_type text, out upper_bound_ns bigint, out count bigint)
+returns setof record as 'supautils', 'supautils_hook_latency' language c;
+create or replace function supautils_hook_latency_reset()
+returns void as 'supautils', 'supautils_hook_latency_reset' language c;
+\echo
+
+select supautils_hook_latency_reset();
+
+-- nothing is recorded when tracking is off
+create table latency_t();
+drop table latency_t;
+select count(*) from supautils_hook_latency();
+
+-- utility statements are recorded per node type
+set supautils.track_hook_latency = true;
+create table latency_t();
+drop table latency_t;
+reset supautils.track_hook_latency;
+\echo
+
+select hook, node_type, sum(count) from supautils_hook_latency() where hook = 'process_utility' group by hook, node_type order by node_type collate "C";
@@ -31,3 +31,8 @@ alter system set supautils.constrained_extensions to '{"plrust": {"disk": 123}}'
 alter system set supautils.constrained_extensions to '{"plrust": {"mem": 456}}';
 alter system set supautils.constrained_extensions to '{"plrust": {"mem": ""}}';
 alter system set supautils.constrained_extensions to '{"plrust": 123}';
+alter system set supautils.constrained_extensions to '{"plrust": {"concurrency": "2"}}';
+alter system set supautils.constrained_extensions to '{"plrust": {"concurrency": 0}}';
+alter system set supautils.constrained_extensions to '{"plrust": {"concurrency": 1.5}}';
+alter system set supautils.constrained_extensions to '{"plrust": {"concurrency": 1e9}}';
+alter system set supautils.constrained_extensions to '{"plrust": {"concurrency": 99999999999}}';
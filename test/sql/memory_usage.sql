@@ -0,0 +1,7 @@
+create or replace function supautils_memory_usage(out context text, out total_bytes bigint)
+returns setof record as 'supautils', 'supautils_memory_usage' language c;
+\echo
+
+-- the parsed configs are allocated in their own contexts, the reserved
+-- memberships closure is only built in transitive mode
+select context, total_bytes > 0 as allocated from supautils_memory_usage() order by context collate "C";
@@ -98,6 +98,33 @@ alter table referencing_hint
     add constraint referencing_hint_fk foreign key (id) references hint_target(id);
 \echo
 
+-- the hint of a retried statement is cached until the grants change
+prepare hint_retry as insert into hint_target values (3) returning id;
+execute hint_retry;
+execute hint_retry;
+reset role;
+grant select on hint_target to hint_role;
+set role hint_role;
+execute hint_retry;
+reset role;
+revoke select on hint_target from hint_role;
+set role hint_role;
+deallocate hint_retry;
+\echo
+
+-- column privileges, only the privileges missing on some column are hinted
+reset role;
+create table hint_wide(a int, b int, c int);
+grant select (a, b), update (a) on hint_wide to hint_role;
+set role hint_role;
+select * from hint_wide;
+update hint_wide set a = 1 where b = 1;
+update hint_wide set b = 1 where c = 1;
+reset role;
+drop table hint_wide;
+set role hint_role;
+\echo
+
 -- views rely on the owner's privileges, ensure hints still fire
 select * from hint_view;
 \echo
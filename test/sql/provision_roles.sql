@@ -0,0 +1,47 @@
+create or replace function supautils_provision_roles(roles jsonb, out role text, out status text)
+returns setof record as 'supautils', 'supautils_provision_roles' language c;
+\echo
+
+set role rolecreator;
+
+-- the whole batch is rejected when a role is reserved
+select * from supautils_provision_roles('[{"role": "tenant_1"}, {"role": "anon"}]');
+
+-- or when a membership is reserved
+select * from supautils_provision_roles('[{"role": "tenant_1"}, {"role": "tenant_2", "member_of": ["pg_read_server_files"]}]');
+
+-- nothing was created
+select count(*) from pg_roles where rolname like 'tenant\_%';
+
+select * from supautils_provision_roles('[{"role": "tenant_1", "login": true, "member_of": ["pg_monitor"]}, {"role": "tenant_2"}]');
+
+select rolname, rolcanlogin from pg_roles where rolname like 'tenant\_%' order by rolname collate "C";
+
+select r.rolname as member, m.rolname as role
+from pg_auth_members am
+join pg_roles r on r.oid = am.member
+join pg_roles m on m.oid = am.roleid
+where r.rolname like 'tenant\_%'
+order by 1 collate "C", 2 collate "C";
+
+-- existing roles are skipped so the batch can be retried
+select * from supautils_provision_roles('[{"role": "tenant_2"}, {"role": "tenant_3"}]');
+
+-- existing roles get the memberships they don't have yet
+select * from supautils_provision_roles('[{"role": "tenant_1", "member_of": ["pg_monitor"]}, {"role": "tenant_2", "member_of": ["pg_monitor"]}]');
+
+select r.rolname as member, m.rolname as role
+from pg_auth_members am
+join pg_roles r on r.oid = am.member
+join pg_roles m on m.oid = am.roleid
+where r.rolname like 'tenant\_%'
+order by 1 collate "C", 2 collate "C";
+
+-- invalid input
+select * from supautils_provision_roles('{"role": "tenant_4"}');
+select * from supautils_provision_roles('[{"role": "tenant_4", "login": "yes"}]');
+select * from supautils_provision_roles('[{"role": "tenant_4", "member_of": "pg_monitor"}]');
+select * from supautils_provision_roles('[{"login": true}]');
+
+reset role;
+drop role tenant_1, tenant_2, tenant_3;
@@ -24,3 +24,32 @@ grant pg_read_all_stats to fake;
 -- can grant non-reserved memberships when creating a role
 create role tester in role anon;
 create role other admin anon;
+\echo
+
+-- transitive memberships
+reset role;
+create role member_of_reserved;
+create role nested_member;
+grant pg_read_server_files to member_of_reserved;
+grant member_of_reserved to nested_member;
+grant member_of_reserved, nested_member to rolecreator with admin option;
+set supautils.transitive_reserved_memberships = on;
+set role rolecreator;
+\echo
+
+-- cannot grant roles that are members of reserved memberships
+grant member_of_reserved to fake;
+grant nested_member to fake;
+create role nested_tester in role nested_member;
+\echo
+
+-- the closure follows membership changes
+reset role;
+revoke pg_read_server_files from member_of_reserved;
+set role rolecreator;
+grant nested_member to fake;
+\echo
+
+reset role;
+reset supautils.transitive_reserved_memberships;
+drop role nested_member, member_of_reserved;
@@ -12,6 +12,25 @@ select set_config('response.headers', '[{"X-Content-Type-Options": "nosniff"}]',
 set another.placeholder to 'special-value';
 \echo
 
+-- values with non-ASCII characters are checked too
+set another.placeholder to 'ÜBER-SPECIAL-VALUE';
+\echo
+
+-- repeated values are checked the same way
+select set_config('response.headers', '[{"Cache-Control": "public"}]', true);
+select set_config('response.headers', '[{"Cache-Control": "public"}]', true);
+select set_config('response.headers', '[{"Content-Type": "text/html"}]', true);
+select set_config('response.headers', '[{"Content-Type": "text/html"}]', true);
+\echo
+
+-- values longer than supautils.placeholders_max_length are rejected
+set supautils.placeholders_max_length to 16;
+select set_config('response.headers', '[{"Cache-Control": "public"}]', true);
+set another.placeholder to 'short-value';
+show another.placeholder;
+reset supautils.placeholders_max_length;
+\echo
+
 -- doesn't crash after a show all
 \o /dev/null
 show all;
@@ -0,0 +1,20 @@
+create or replace function supautils_stats(out feature text, out outcome text, out count bigint)
+returns setof record as 'supautils', 'supautils_stats' language c;
+create or replace function supautils_stats_reset()
+returns void as 'supautils', 'supautils_stats_reset' language c;
+\echo
+
+select supautils_stats_reset();
+
+-- every counter is zero after a reset
+select count(*) from supautils_stats() where count > 0;
+
+-- rejected reserved roles and memberships are counted
+set role rolecreator;
+drop role anon;
+alter role supabase_storage_admin nologin;
+grant pg_read_server_files to fake;
+reset role;
+\echo
+
+select feature, outcome, count from supautils_stats() where count > 0 order by feature, outcome;
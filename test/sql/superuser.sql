@@ -0,0 +1,7 @@
+-- an existing supautils.superuser is accepted
+alter system set supautils.superuser = 'superuser_for_test';
+alter system reset supautils.superuser;
+
+-- a missing supautils.superuser is reported early
+alter system set supautils.superuser = 'missing_superuser';
+alter system reset supautils.superuser;
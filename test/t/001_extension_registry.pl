@@ -0,0 +1,84 @@
+# The extension registry needs supautils in shared_preload_libraries, so it's
+# tested on its own cluster.
+use strict;
+use warnings;
+
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $node = PostgreSQL::Test::Cluster->new('extension_registry');
+$node->init;
+$node->append_conf(
+	'postgresql.conf', q{
+shared_preload_libraries = 'supautils'
+supautils.extension_registry = on
+supautils.privileged_role = 'privileged_role'
+supautils.privileged_extensions = 'hstore, no_control_file_extension'
+supautils.restrict_extension_versions = warn
+});
+$node->start;
+
+$node->safe_psql(
+	'postgres', q{
+create role privileged_role;
+create function supautils_extension_registry(out name text, out default_version text, out requires text)
+returns setof record as 'supautils', 'supautils_extension_registry' language c;
+});
+
+$node->poll_query_until('postgres',
+	'select count(*) > 0 from supautils_extension_registry()')
+  or die 'timed out waiting for the extension registry';
+
+# the secondary control files are skipped like in pg_available_extensions
+is( $node->safe_psql(
+		'postgres', q{
+select count(*)
+from supautils_extension_registry() r
+full join pg_available_extensions a using (name)
+where r.name is null or a.name is null
+   or r.default_version is distinct from a.default_version
+}),
+	'0',
+	'the registry indexes the same extensions as pg_available_extensions');
+
+is( $node->safe_psql(
+		'postgres',
+		"select requires from supautils_extension_registry() where name = 'earthdistance'"
+	),
+	'cube',
+	'requires is indexed');
+
+# lookups of an indexed extension
+my $default_version = $node->safe_psql('postgres',
+	"select default_version from pg_available_extensions where name = 'hstore'"
+);
+my ($ret, $stdout, $stderr) = $node->psql(
+	'postgres', q{
+set role privileged_role;
+create extension hstore version '1.4';
+});
+is($ret, 0, 'privileged extension found in the registry is created');
+like(
+	$stderr,
+	qr/DETAIL:  The default version of "hstore" is \Q$default_version\E\./,
+	'the warning names the default version from the registry');
+is( $node->safe_psql(
+		'postgres',
+		"select extowner::regrole from pg_extension where extname = 'hstore'"),
+	$node->safe_psql('postgres', 'select current_user'),
+	'the privileged extension is created as superuser');
+
+# lookups of an extension that isn't indexed go to pg_available_extensions
+($ret, $stdout, $stderr) = $node->psql(
+	'postgres', q{
+set role privileged_role;
+create extension no_control_file_extension;
+});
+isnt($ret, 0, 'missing privileged extension is not created');
+unlike($stderr, qr/permission denied/,
+	'missing privileged extension is not reported as a privilege error');
+
+$node->stop;
+
+done_testing();
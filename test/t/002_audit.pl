@@ -0,0 +1,91 @@
+# Auditing needs supautils in shared_preload_libraries, so it's tested on its
+# own cluster.
+use strict;
+use warnings;
+
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $node = PostgreSQL::Test::Cluster->new('audit');
+$node->init;
+$node->append_conf(
+	'postgresql.conf', q{
+shared_preload_libraries = 'supautils'
+supautils.audit = on
+supautils.privileged_role = 'privileged_role'
+supautils.privileged_extensions = 'hstore'
+supautils.reserved_roles = 'reserved_role'
+});
+$node->start;
+
+my $superuser = $node->safe_psql('postgres', 'select current_user');
+
+$node->safe_psql(
+	'postgres', q{
+create role privileged_role createrole;
+create role reserved_role;
+});
+
+# escalated and handled
+$node->safe_psql(
+	'postgres', q{
+set role privileged_role;
+create extension hstore;
+});
+
+# escalated, then left to postgres which fails since the extension is owned
+# by the superuser
+$node->psql(
+	'postgres', q{
+set role privileged_role;
+alter extension hstore update;
+});
+
+# left to postgres without escalating
+$node->safe_psql(
+	'postgres', q{
+set role privileged_role;
+drop role if exists not_audited;
+});
+
+# objects without a name, like casts, are still audited
+is( $node->psql(
+		'postgres', q{
+create type audit_pair as (a int);
+create function audit_pair_int(audit_pair) returns int
+  language sql as 'select $1.a';
+create cast (audit_pair as int) with function audit_pair_int(audit_pair);
+comment on cast (audit_pair as int) is 'audited';
+drop cast (audit_pair as int);
+}),
+	0,
+	'statements on casts run with auditing on');
+
+# rejected, the records are written in order so the ones above are there too
+# once this one is
+$node->psql(
+	'postgres', q{
+set role privileged_role;
+alter role reserved_role nologin;
+});
+
+$node->poll_query_until('postgres',
+	"select pg_read_file('supautils_audit.csv') like '%ALTER ROLE%'")
+  or die 'timed out waiting for the audit records';
+
+my @records = map { s/^[^,]+,//r }
+  split /\n/, slurp_file($node->data_dir . '/supautils_audit.csv');
+
+is_deeply(
+	\@records,
+	[
+		qq{"privileged_role","$superuser",CREATE EXTENSION,"hstore",succeeded},
+		qq{"privileged_role","$superuser",ALTER EXTENSION,"hstore",failed},
+		qq{"privileged_role",,ALTER ROLE,"reserved_role",failed},
+	],
+	'escalated and rejected statements are audited');
+
+$node->stop;
+
+done_testing();
@@ -0,0 +1,307 @@
+/*
+ * Validates the JSON configs of supautils in a postgresql.conf file without a
+ * running server, with the same parsers as the extension. Reports the number
+ * of entries of each config against its limit and, with -b, the time it takes
+ * to parse it.
+ *
+ *   supautils_config_check [-b iterations] postgresql.conf
+ */
+#include "pg_prelude.h"
+
+#include <ctype.h>
+#include <unistd.h>
+
+#include "config_ceilings.h"
+#include "constrained_extensions.h"
+#include "drop_trigger_grants.h"
+#include "extensions_parameter_overrides.h"
+#include "policy_grants.h"
+
+typedef struct {
+  int         entries;
+  // the largest list of tables of an entry, for the grants
+  int         max_tables;
+  const char *error;
+} parse_result;
+
+typedef struct {
+  const char *name;
+  int         max_entries;
+  int         max_tables; // 0 when the entries have no tables
+  parse_result (*parse)(const char *value);
+} json_config;
+
+// the parsers append to the entries, so they're cleared before every parse and
+// their strings are freed after it, -b would otherwise leak on every iteration
+static constrained_extension         cexts[MAX_CONSTRAINED_EXTENSIONS];
+static extension_parameter_overrides epos[MAX_EXTENSIONS_PARAMETER_OVERRIDES];
+static policy_grants                 pgs[MAX_POLICY_GRANTS];
+static drop_trigger_grants           dtgs[MAX_DROP_TRIGGER_GRANTS];
+static config_ceiling                ceilings[MAX_CONFIG_CEILINGS];
+
+static void free_tables(char *role_name, char **table_names,
+                        size_t total_tables) {
+  pg_free(role_name);
+  for (size_t i = 0; i < total_tables; i++)
+    pg_free(table_names[i]);
+}
+
+static parse_result parse_cexts(const char *value) {
+  json_constrained_extension_parse_state state;
+
+  memset(cexts, 0, sizeof(cexts));
+  state = parse_constrained_extensions(value, cexts);
+
+  // an entry past the total can be half parsed
+  for (int i = 0; i <= state.total_cexts && i < MAX_CONSTRAINED_EXTENSIONS; i++)
+    pg_free(cexts[i].name);
+
+  return (parse_result){state.total_cexts, 0, state.error_msg};
+}
+
+static parse_result parse_epos(const char *value) {
+  json_extension_parameter_overrides_parse_state state;
+
+  memset(epos, 0, sizeof(epos));
+  state = parse_extensions_parameter_overrides(value, epos);
+
+  for (int i = 0;
+       i <= state.total_epos && i < MAX_EXTENSIONS_PARAMETER_OVERRIDES; i++) {
+    pg_free(epos[i].name);
+    pg_free(epos[i].schema);
+  }
+
+  return (parse_result){state.total_epos, 0, state.error_msg};
+}
+
+static parse_result parse_pgs(const char *value) {
+  json_policy_grants_parse_state state;
+  int                            max_tables = 0;
+
+  memset(pgs, 0, sizeof(pgs));
+  state = parse_policy_grants(value, pgs);
+
+  for (int i = 0; i < state.total_pgs; i++)
+    max_tables = Max(max_tables, (int)pgs[i].total_tables);
+
+  for (int i = 0; i <= state.total_pgs && i < MAX_POLICY_GRANTS; i++)
+    free_tables(pgs[i].role_name, pgs[i].table_names, pgs[i].total_tables);
+
+  return (parse_result){state.total_pgs, max_tables, state.error_msg};
+}
+
+static parse_result parse_dtgs(const char *value) {
+  json_drop_trigger_grants_parse_state state;
+  int                                  max_tables = 0;
+
+  memset(dtgs, 0, sizeof(dtgs));
+  state = parse_drop_trigger_grants(value, dtgs);
+
+  for (int i = 0; i < state.total_dtgs; i++)
+    max_tables = Max(max_tables, (int)dtgs[i].total_tables);
+
+  for (int i = 0; i <= state.total_dtgs && i < MAX_DROP_TRIGGER_GRANTS; i++)
+    free_tables(dtgs[i].role_name, dtgs[i].table_names, dtgs[i].total_tables);
+
+  return (parse_result){state.total_dtgs, max_tables, state.error_msg};
+}
+
+static parse_result parse_ceilings(const char *value) {
+  json_config_ceilings_parse_state state;
+
+  memset(ceilings, 0, sizeof(ceilings));
+  state = parse_config_ceilings(value, ceilings);
+
+  for (int i = 0; i <= state.total_ceilings && i < MAX_CONFIG_CEILINGS; i++) {
+    pg_free(ceilings[i].name);
+    pg_free(ceilings[i].ceiling);
+  }
+
+  return (parse_result){state.total_ceilings, 0, state.error_msg};
+}
+
+static const json_config json_configs[] = {
+  {"supautils.constrained_extensions", MAX_CONSTRAINED_EXTENSIONS, 0,
+   parse_cexts},
+  {"supautils.extensions_parameter_overrides",
+   MAX_EXTENSIONS_PARAMETER_OVERRIDES, 0, parse_epos},
+  {"supautils.policy_grants", MAX_POLICY_GRANTS, MAX_POLICY_GRANT_TABLES,
+   parse_pgs},
+  {"supautils.drop_trigger_grants", MAX_DROP_TRIGGER_GRANTS,
+   MAX_DROP_TRIGGER_GRANT_TABLES, parse_dtgs},
+  {"supautils.privileged_role_config_ceilings", MAX_CONFIG_CEILINGS, 0,
+   parse_ceilings},
+};
+
+static char *read_file(const char *path) {
+  FILE  *file = fopen(path, "r");
+  char  *buf;
+  size_t len  = 0;
+  size_t size = 8192;
+
+  if (file == NULL) {
+    pg_log_error("could not open file \"%s\": %m", path);
+    exit(2);
+  }
+
+  buf = pg_malloc(size);
+  for (;;) {
+    len += fread(buf + len, 1, size - len - 1, file);
+    if (len < size - 1) break;
+    size *= 2;
+    buf = pg_realloc(buf, size);
+  }
+
+  if (ferror(file)) {
+    pg_log_error("could not read file \"%s\": %m", path);
+    exit(2);
+  }
+
+  fclose(file);
+  buf[len] = '\0';
+
+  return buf;
+}
+
+// Unquotes a value in place, with the escapes of postgresql.conf. Returns
+// NULL when the quotes aren't closed.
+static char *unquote(char *str) {
+  char *out = str;
+
+  for (char *in = str + 1; *in != '\0'; in++) {
+    if (*in == '\'') {
+      if (in[1] != '\'') {
+        *out = '\0';
+        return str;
+      }
+      in++;
+    } else if (*in == '\\' && in[1] != '\0') {
+      in++;
+      switch (*in) {
+      case 'b': *out++ = '\b'; continue;
+      case 'f': *out++ = '\f'; continue;
+      case 'n': *out++ = '\n'; continue;
+      case 'r': *out++ = '\r'; continue;
+      case 't': *out++ = '\t'; continue;
+      default: break;
+      }
+    }
+    *out++ = *in;
+  }
+
+  return NULL;
+}
+
+// Splits a "name = value" line, returns false for blank and comment lines.
+static bool parse_line(char *line, char **name, char **value) {
+  char *p = line;
+
+  while (isspace((unsigned char)*p))
+    p++;
+
+  if (*p == '\0' || *p == '#') return false;
+
+  *name = p;
+  while (*p != '\0' && *p != '=' && !isspace((unsigned char)*p))
+    p++;
+
+  if (*p != '\0') *p++ = '\0';
+
+  while (isspace((unsigned char)*p) || *p == '=')
+    p++;
+
+  if (*p == '\'') {
+    *value = unquote(p);
+  } else {
+    *value = p;
+    while (*p != '\0' && *p != '#' && !isspace((unsigned char)*p))
+      p++;
+    *p = '\0';
+  }
+
+  return true;
+}
+
+static bool check_config(const json_config *config, const char *value,
+                         int iterations) {
+  parse_result result = {0};
+  instr_time   start, duration;
+
+  INSTR_TIME_SET_CURRENT(start);
+  for (int i = 0; i < iterations; i++)
+    result = config->parse(value);
+  INSTR_TIME_SET_CURRENT(duration);
+  INSTR_TIME_SUBTRACT(duration, start);
+
+  if (result.error != NULL) {
+    printf("%s: invalid, %s\n", config->name, result.error);
+    return false;
+  }
+
+  printf("%s: %d of %d entries", config->name, result.entries,
+         config->max_entries);
+
+  if (config->max_tables > 0)
+    printf(", at most %d of %d tables per role", result.max_tables,
+           config->max_tables);
+
+  if (iterations > 1)
+    printf(", parsed in %.1f us on average",
+           INSTR_TIME_GET_MICROSEC(duration) / (double)iterations);
+
+  printf("\n");
+
+  return true;
+}
+
+static void usage(const char *progname) {
+  fprintf(stderr, "usage: %s [-b iterations] postgresql.conf\n", progname);
+  exit(2);
+}
+
+int main(int argc, char *argv[]) {
+  int   iterations = 1;
+  bool  valid      = true;
+  int   found      = 0;
+  int   opt;
+  char *conf;
+  char *line;
+
+  pg_logging_init(argv[0]);
+
+  while ((opt = getopt(argc, argv, "b:")) != -1) {
+    switch (opt) {
+    case 'b': iterations = atoi(optarg); break;
+    default: usage(argv[0]);
+    }
+  }
+
+  if (iterations <= 0 || optind != argc - 1) usage(argv[0]);
+
+  conf = read_file(argv[optind]);
+
+  // a config set twice is checked twice, the server uses the last one
+  while ((line = strsep(&conf, "\n")) != NULL) {
+    char *name;
+    char *value;
+
+    if (!parse_line(line, &name, &value)) continue;
+
+    for (size_t i = 0; i < lengthof(json_configs); i++) {
+      if (strcmp(name, json_configs[i].name) != 0) continue;
+
+      found++;
+
+      if (value == NULL) {
+        printf("%s: invalid, unterminated quoted string\n", name);
+        valid = false;
+      } else if (!check_config(&json_configs[i], value, iterations)) {
+        valid = false;
+      }
+    }
+  }
+
+  if (found == 0) printf("no supautils JSON configs found\n");
+
+  return valid ? 0 : 1;
+}